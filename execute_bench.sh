@@ -0,0 +1,223 @@
+#!/bin/bash
+
+# Bateria de experimentos do k-means: roda a matriz variante x classe x processos x threads,
+# com WARMUP execuções descartadas e REPS repetições medidas por configuração, e calcula
+# média, desvio padrão, mediana, speedup e eficiência (forte e fraca) em relação ao serial.
+#
+# Tudo é configurável por variáveis de ambiente, por exemplo:
+# VARIANTS="serial mpi" CLASSES="D E F" RANKS="1 2 4 8" REPS=5 ./execute_bench.sh
+# VARIANTS=mpi MAKE_FLAGS="HYBRID=ON" RANKS="1 2" THREADS="1 4" ./execute_bench.sh
+#
+# Saídas (prefixo OUT, padrão resultado/bench):
+# <OUT>.raw   uma linha por execução medida (variante classe processos threads repetição tempo verificação trabalho)
+# <OUT>.dat   estatísticas por configuração, colunas separadas por espaço (gnuplot: using 3:6:7 with yerrorbars)
+# <OUT>.jsonl relatório estruturado de cada execução medida (KMEANS_REPORT_FILE)
+#
+# Cada execução confere no relatório quantas threads usou de fato: sem THREADS=ON (serial)
+# ou HYBRID=ON (mpi, phases-parallels) em MAKE_FLAGS o binário usa uma thread, e as entradas de
+# THREADS maiores que 1 são puladas.
+#
+# Speedup forte: tempo médio do BASELINE (1 processo, 1 thread) na mesma classe / tempo médio.
+# Eficiência fraca: vazão por unidade de processamento (N * K * iterações / (processos * threads * tempo))
+# dividida pela vazão do BASELINE na classe cujo trabalho mais se aproxima do trabalho por unidade.
+
+VARIANTS=${VARIANTS:-"serial mpi phases-parallels"}
+CLASSES=${CLASSES:-"D E F"}
+RANKS=${RANKS:-"1 2 4 8"}
+THREADS=${THREADS:-"1"}
+REPS=${REPS:-5}
+WARMUP=${WARMUP:-1}
+BASELINE=${BASELINE:-"serial"}
+# parâmetros extras do make (ex.: "TIMER=ON HYBRID=ON") e do mpirun
+MAKE_FLAGS=${MAKE_FLAGS:-""}
+MPIRUN=${MPIRUN:-"mpirun --oversubscribe"}
+# máximo de iterações do phases-parallels
+MAX_ITER=${MAX_ITER:-200}
+
+ROOT=$(cd "$(dirname "$0")" && pwd)
+OUT=${OUT:-$ROOT"/resultado/bench"}
+
+mkdir -p "$(dirname "$OUT")"
+> "$OUT.raw"
+> "$OUT.jsonl"
+logfile=$(mktemp)
+record=$(mktemp)
+trap 'rm -f "$logfile" "$record"' EXIT
+
+# executa uma vez a configuração (measured=1 guarda o relatório em <OUT>.jsonl); imprime
+# "tempo verificação trabalho", "falhou" ou "pulada <threads>" quando o binário usou outro
+# número de threads
+run_once(){
+    local variant=$1 class=$2 ranks=$3 threads=$4 measured=$5
+    > "$record"
+    case $variant in
+        serial)
+            KMEANS_THREADS=$threads OMP_NUM_THREADS=$threads KMEANS_REPORT_FILE=$record \
+                ./k_means.$class.exe > "$logfile" 2>&1 ;;
+        phases-parallels)
+            OMP_NUM_THREADS=$threads KMEANS_REPORT_FILE=$record \
+                $MPIRUN -np $ranks -x OMP_NUM_THREADS -x KMEANS_REPORT_FILE ./k_means.$class.exe file $MAX_ITER > "$logfile" 2>&1 ;;
+        *)
+            OMP_NUM_THREADS=$threads KMEANS_REPORT_FILE=$record \
+                $MPIRUN -np $ranks -x OMP_NUM_THREADS -x KMEANS_REPORT_FILE ./k_means.$class.exe > "$logfile" 2>&1 ;;
+    esac
+    if [ $? -ne 0 ]; then
+        echo "falhou"
+        return
+    fi
+    local seconds=$(sed -n 's/.*Execution time in seconds *= *\([0-9.]*\).*/\1/p' "$logfile" | head -n 1)
+    # SUCCESSFUL, UNSUCCESSFUL ou NOT_PERFORMED (phases-parallels, sem solução de referência)
+    local verification=$(sed -n 's/.*Correctness verification *= *\([A-Z ]*[A-Z]\).*/\1/p' "$logfile" | head -n 1 | tr ' ' '_')
+    # trabalho da execução: distâncias calculadas (N * K * iterações)
+    local work=$(awk '{
+        n = k = it = 0
+        if(match($0, /"n_points":[0-9]+/)) n = substr($0, RSTART + 11, RLENGTH - 11)
+        if(match($0, /"n_means":[0-9]+/)) k = substr($0, RSTART + 10, RLENGTH - 10)
+        if(match($0, /"iterations":[0-9]+/)) it = substr($0, RSTART + 13, RLENGTH - 13)
+        printf "%.0f", n * k * it
+    }' "$record")
+    # threads que a execução usou de fato
+    local used=$(sed -n 's/.*"threads":\([0-9]*\).*/\1/p' "$record" | head -n 1)
+    if [ -z "$seconds" ]; then
+        echo "falhou"
+        return
+    fi
+    if [ -n "$used" ] && [ "$used" -ne "$threads" ]; then
+        echo "pulada $used"
+        return
+    fi
+    if [ "$measured" = "1" ]; then
+        cat "$record" >> "$OUT.jsonl"
+    fi
+    echo "$seconds ${verification:-UNKNOWN} ${work:-0}"
+}
+
+for class in $CLASSES
+do
+    for variant in $VARIANTS
+    do
+        echo "Compilando $variant, classe $class"
+        cd "$ROOT/$variant" || exit 1
+        make data_generator k_means WORKLOAD=$class $MAKE_FLAGS > "$logfile" 2>&1
+        if [ $? -ne 0 ]; then
+            cat "$logfile"
+            echo "Erro na compilação de $variant '$class'. Abortando."
+            exit 1
+        fi
+        [ -f data.$class.txt ] || [ -f data.$class.bin ] || ./data_generator.$class.exe $class > /dev/null
+
+        for ranks in $RANKS
+        do
+            # o serial roda com um único processo
+            if [ "$variant" = "serial" ] && [ "$ranks" -ne 1 ]; then
+                continue
+            fi
+            for threads in $THREADS
+            do
+                echo -n "$variant classe $class processos $ranks threads $threads:"
+                for rep in $(seq $WARMUP)
+                do
+                    run_once $variant $class $ranks $threads 0 > /dev/null
+                done
+                for rep in $(seq $REPS)
+                do
+                    result=$(run_once $variant $class $ranks $threads 1)
+                    if [ "${result%% *}" = "pulada" ]; then
+                        echo -n " pulada (o binário usou ${result#* } thread(s): faltam THREADS=ON ou HYBRID=ON em MAKE_FLAGS)"
+                        break
+                    fi
+                    echo -n " $(echo $result | cut -d ' ' -f 1)"
+                    echo "$variant $class $ranks $threads $rep $result" >> "$OUT.raw"
+                done
+                echo
+            done
+        done
+    done
+done
+
+# estatísticas por configuração (awk portável: sem asort)
+awk -v baseline="$BASELINE" '
+function sort(a, n,    i, j, v){
+    for(i = 2; i <= n; i++){
+        v = a[i]
+        for(j = i - 1; j >= 1 && a[j] > v; j--) a[j + 1] = a[j]
+        a[j + 1] = v
+    }
+}
+{
+    key = $1 " " $2 " " $3 " " $4
+    if(!(key in runs)){
+        order[++n_keys] = key
+        runs[key] = 0
+        failed[key] = 0
+    }
+    if($6 == "falhou" || ($7 != "SUCCESSFUL" && $7 != "NOT_PERFORMED")){
+        failed[key]++
+        next
+    }
+    times[key, ++runs[key]] = $6
+    work[key] = $8
+}
+END{
+    for(k = 1; k <= n_keys; k++){
+        key = order[k]
+        m = runs[key]
+        sum = 0
+        for(i = 1; i <= m; i++){
+            v[i] = times[key, i]
+            sum += v[i]
+        }
+        if(m == 0) continue
+        mean[key] = sum / m
+        squares = 0
+        for(i = 1; i <= m; i++) squares += (v[i] - mean[key]) ^ 2
+        deviation[key] = (m > 1) ? sqrt(squares / (m - 1)) : 0
+        sort(v, m)
+        median[key] = (m % 2) ? v[(m + 1) / 2] : (v[m / 2] + v[m / 2 + 1]) / 2
+        minimum[key] = v[1]
+        maximum[key] = v[m]
+        split(key, f, " ")
+        if(f[1] == baseline && f[3] == 1 && f[4] == 1){
+            base_time[f[2]] = mean[key]
+            if(work[key] > 0) base_rate[f[2]] = work[key] / mean[key]
+        }
+    }
+
+    printf "# variante classe processos threads execucoes media desvio mediana minimo maximo speedup eficiencia eficiencia_fraca falhas\n"
+    for(k = 1; k <= n_keys; k++){
+        key = order[k]
+        split(key, f, " ")
+        if(!(key in mean)){
+            printf "%s %s %s %s 0 nan nan nan nan nan nan nan nan %d\n", f[1], f[2], f[3], f[4], failed[key]
+            continue
+        }
+        units = f[3] * f[4]
+        speedup = efficiency = weak = "nan"
+        if(f[2] in base_time){
+            speedup = sprintf("%.3f", base_time[f[2]] / mean[key])
+            efficiency = sprintf("%.3f", speedup / units)
+        }
+        # classe do baseline com o trabalho mais próximo do trabalho por unidade
+        if(work[key] > 0){
+            target = work[key] / units
+            best = ""
+            for(c in base_rate){
+                distance = log(base_rate[c] * base_time[c] / target)
+                if(distance < 0) distance = -distance
+                if(best == "" || distance < best_distance){
+                    best = c
+                    best_distance = distance
+                }
+            }
+            if(best != "") weak = sprintf("%.3f", (work[key] / (units * mean[key])) / base_rate[best])
+        }
+        printf "%s %s %s %s %d %.6f %.6f %.6f %.6f %.6f %s %s %s %d\n", f[1], f[2], f[3], f[4], runs[key],
+            mean[key], deviation[key], median[key], minimum[key], maximum[key], speedup, efficiency, weak, failed[key]
+    }
+}' "$OUT.raw" > "$OUT.dat"
+
+echo
+awk '{
+    if(NR == 1) sub(/^# /, "")
+    printf "%-18s %-6s %9s %7s %8s %10s %10s %10s %10s %10s %8s %10s %16s %6s\n", $1, $2, $3, $4, $5, $6, $7, $8, $9, $10, $11, $12, $13, $14
+}' "$OUT.dat"
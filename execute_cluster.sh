@@ -4,86 +4,79 @@ TEMPFILE="../resultado/tempo_cluster"
 
 echo "Compilando arquivos"
 cd ./phases-parallels
-make WORKLOAD=D
-make WORKLOAD=E
-make WORKLOAD=F
-make WORKLOAD=G
-make WORKLOAD=H
+make data_generator WORKLOAD=H
+make k_means_runtime
 
 echo "Executando data_generator"
-./data_generator.D.exe
-./data_generator.E.exe
-./data_generator.F.exe
-./data_generator.G.exe
-./data_generator.H.exe
+./data_generator.H.exe D E F G H
 
 echo "Obtendo resultados"
 echo "NUMERO PROCESSOS: 1 WORKLOAD: D " >> $TEMPFILE
-{ time mpirun -np 1 --oversubscribe ./k_means.D.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 1 --oversubscribe ./k_means.runtime.exe file 200 D; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 8 WORKLOAD: D " >> $TEMPFILE
-{ time mpirun -np 8 --oversubscribe ./k_means.D.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 8 --oversubscribe ./k_means.runtime.exe file 200 D; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 16 WORKLOAD: D " >> $TEMPFILE
-{ time mpirun -np 16 --oversubscribe ./k_means.D.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 16 --oversubscribe ./k_means.runtime.exe file 200 D; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 32 WORKLOAD: D " >> $TEMPFILE
-{ time mpirun -np 32 --oversubscribe ./k_means.D.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 32 --oversubscribe ./k_means.runtime.exe file 200 D; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 64 WORKLOAD: D " >> $TEMPFILE
-{ time mpirun -np 64 --oversubscribe ./k_means.D.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 64 --oversubscribe ./k_means.runtime.exe file 200 D; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 96 WORKLOAD: D " >> $TEMPFILE
-{ time mpirun -np 96 --oversubscribe ./k_means.D.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 96 --oversubscribe ./k_means.runtime.exe file 200 D; } >> $RESULTFILE 2>> $TEMPFILE
 
 
 echo "NUMERO PROCESSOS: 1 WORKLOAD: E " >> $TEMPFILE
-{ time mpirun -np 1 --oversubscribe ./k_means.E.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 1 --oversubscribe ./k_means.runtime.exe file 200 E; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 8 WORKLOAD: E " >> $TEMPFILE
-{ time mpirun -np 8 --oversubscribe ./k_means.E.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 8 --oversubscribe ./k_means.runtime.exe file 200 E; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 16 WORKLOAD: E " >> $TEMPFILE
-{ time mpirun -np 16 --oversubscribe ./k_means.E.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 16 --oversubscribe ./k_means.runtime.exe file 200 E; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 32 WORKLOAD: E " >> $TEMPFILE
-{ time mpirun -np 32 --oversubscribe ./k_means.E.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 32 --oversubscribe ./k_means.runtime.exe file 200 E; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 64 WORKLOAD: E " >> $TEMPFILE
-{ time mpirun -np 64 --oversubscribe ./k_means.E.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 64 --oversubscribe ./k_means.runtime.exe file 200 E; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 96 WORKLOAD: E " >> $TEMPFILE
-{ time mpirun -np 96 --oversubscribe ./k_means.E.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 96 --oversubscribe ./k_means.runtime.exe file 200 E; } >> $RESULTFILE 2>> $TEMPFILE
 
 
 echo "NUMERO PROCESSOS: 1 WORKLOAD: F " >> $TEMPFILE
-{ time mpirun -np 1 --oversubscribe ./k_means.F.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 1 --oversubscribe ./k_means.runtime.exe file 200 F; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 8 WORKLOAD: F " >> $TEMPFILE
-{ time mpirun -np 8 --oversubscribe ./k_means.F.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 8 --oversubscribe ./k_means.runtime.exe file 200 F; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 16 WORKLOAD: F " >> $TEMPFILE
-{ time mpirun -np 16 --oversubscribe ./k_means.F.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 16 --oversubscribe ./k_means.runtime.exe file 200 F; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 32 WORKLOAD: F " >> $TEMPFILE
-{ time mpirun -np 32 --oversubscribe ./k_means.F.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 32 --oversubscribe ./k_means.runtime.exe file 200 F; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 64 WORKLOAD: F " >> $TEMPFILE
-{ time mpirun -np 64 --oversubscribe ./k_means.F.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 64 --oversubscribe ./k_means.runtime.exe file 200 F; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 96 WORKLOAD: F " >> $TEMPFILE
-{ time mpirun -np 96 --oversubscribe ./k_means.F.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 96 --oversubscribe ./k_means.runtime.exe file 200 F; } >> $RESULTFILE 2>> $TEMPFILE
 
 
 echo "NUMERO PROCESSOS: 1 WORKLOAD: G " >> $TEMPFILE
-{ time mpirun -np 1 --oversubscribe ./k_means.G.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 1 --oversubscribe ./k_means.runtime.exe file 200 G; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 8 WORKLOAD: G " >> $TEMPFILE
-{ time mpirun -np 8 --oversubscribe ./k_means.G.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 8 --oversubscribe ./k_means.runtime.exe file 200 G; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 16 WORKLOAD: G " >> $TEMPFILE
-{ time mpirun -np 16 --oversubscribe ./k_means.G.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 16 --oversubscribe ./k_means.runtime.exe file 200 G; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 32 WORKLOAD: G " >> $TEMPFILE
-{ time mpirun -np 32 --oversubscribe ./k_means.G.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 32 --oversubscribe ./k_means.runtime.exe file 200 G; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 64 WORKLOAD: G " >> $TEMPFILE
-{ time mpirun -np 64 --oversubscribe ./k_means.G.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 64 --oversubscribe ./k_means.runtime.exe file 200 G; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 96 WORKLOAD: G " >> $TEMPFILE
-{ time mpirun -np 96 --oversubscribe ./k_means.G.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 96 --oversubscribe ./k_means.runtime.exe file 200 G; } >> $RESULTFILE 2>> $TEMPFILE
 
 echo "NUMERO PROCESSOS: 1 WORKLOAD: H " >> $TEMPFILE
-{ time mpirun -np 1 --oversubscribe ./k_means.H.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 1 --oversubscribe ./k_means.runtime.exe file 200 H; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 8 WORKLOAD: H " >> $TEMPFILE
-{ time mpirun -np 8 --oversubscribe ./k_means.H.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 8 --oversubscribe ./k_means.runtime.exe file 200 H; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 16 WORKLOAD: H " >> $TEMPFILE
-{ time mpirun -np 16 --oversubscribe ./k_means.H.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 16 --oversubscribe ./k_means.runtime.exe file 200 H; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 32 WORKLOAD: H " >> $TEMPFILE
-{ time mpirun -np 32 --oversubscribe ./k_means.H.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 32 --oversubscribe ./k_means.runtime.exe file 200 H; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 64 WORKLOAD: H " >> $TEMPFILE
-{ time mpirun -np 64 --oversubscribe ./k_means.H.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 64 --oversubscribe ./k_means.runtime.exe file 200 H; } >> $RESULTFILE 2>> $TEMPFILE
 echo "NUMERO PROCESSOS: 96 WORKLOAD: H " >> $TEMPFILE
-{ time mpirun -np 96 --oversubscribe ./k_means.H.exe file 200; } >> $RESULTFILE 2>> $TEMPFILE
+{ time mpirun -np 96 --oversubscribe ./k_means.runtime.exe file 200 H; } >> $RESULTFILE 2>> $TEMPFILE
 
 rm $RESULTFILE
\ No newline at end of file
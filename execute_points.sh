@@ -29,8 +29,12 @@ HOME=$(pwd)
 # Arquivo de log temporario
 mpi=$HOME"/resultado/tempo_points.log"
 
+# Relatorio estruturado (uma linha JSON por execucao)
+export KMEANS_REPORT_FILE=$HOME"/resultado/points.jsonl"
+
 # Limpa/cria arquivos de log
 > "$mpi"
+> "$KMEANS_REPORT_FILE"
 
 cd ./mpi 
 
@@ -42,7 +46,7 @@ do
     for nodes in "${numnodes[@]}"
     do 
         echo -n -e "WORKLOAD: $workload NODES: $nodes" >> "$mpi" 
-        (mpirun -np $nodes --oversubscribe $mpirun.$workload.exe) >> "$logfile" 2>&1
+        (mpirun -np $nodes --oversubscribe -x KMEANS_REPORT_FILE $mpirun.$workload.exe) >> "$logfile" 2>&1
         if [ $? -ne 0 ]; then
             echo "Erro na execução do mpirun -np $nodes '$workload'. Abortando." | tee -a "$mpi"
             exit 1
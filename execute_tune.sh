@@ -0,0 +1,67 @@
+#!/bin/bash
+
+# Auto-tuner de escalabilidade do k-means (variante mpi): roda o tune.<classe>.exe com o maior
+# número de processos (e de threads por processo) considerado, que calibra algumas iterações no
+# próprio data set (sem usar mais threads que os cores dados ao mpirun), mede o custo por ponto x
+# centroide de cada kernel e a latência do MPI_Allreduce por tamanho de mensagem, ajusta o modelo
+# de custo e recomenda processos x threads x kernel que caibam nesses cores. Com LAUNCH=1 compila e executa a configuração recomendada.
+#
+# Exemplos:
+# CLASS=E RANKS=64 ./execute_tune.sh
+# CLASS=F RANKS=16 THREADS=8 LAUNCH=1 ./execute_tune.sh
+#
+# Saída: resultado/tune.<classe>.log (tabela de previsões e a recomendação)
+
+CLASS=${CLASS:-"E"}
+# máximo de processos e de threads por processo (THREADS > 1 compila com HYBRID=ON)
+RANKS=${RANKS:-8}
+THREADS=${THREADS:-1}
+# 1: compila e executa a configuração recomendada
+LAUNCH=${LAUNCH:-0}
+# parâmetros extras do make (ex.: "COMPACT=ON") e do mpirun
+MAKE_FLAGS=${MAKE_FLAGS:-""}
+MPIRUN=${MPIRUN:-"mpirun --oversubscribe"}
+
+ROOT=$(cd "$(dirname "$0")" && pwd)
+OUT=${OUT:-$ROOT"/resultado/tune.$CLASS.log"}
+mkdir -p "$(dirname "$OUT")"
+
+TUNE_FLAGS=$MAKE_FLAGS
+if [ "$THREADS" -gt 1 ]; then
+    TUNE_FLAGS="$TUNE_FLAGS HYBRID=ON"
+fi
+
+cd "$ROOT/mpi" || exit 1
+logfile=$(mktemp)
+trap 'rm -f "$logfile"' EXIT
+
+echo "Compilando o auto-tuner, classe $CLASS"
+make data_generator tune WORKLOAD=$CLASS $TUNE_FLAGS > "$logfile" 2>&1
+if [ $? -ne 0 ]; then
+    cat "$logfile"
+    echo "Erro na compilação do auto-tuner '$CLASS'. Abortando."
+    exit 1
+fi
+[ -f data.$CLASS.txt ] || [ -f data.$CLASS.bin ] || ./data_generator.$CLASS.exe $CLASS > /dev/null
+
+OMP_NUM_THREADS=$THREADS $MPIRUN -np $RANKS -x OMP_NUM_THREADS ./tune.$CLASS.exe > "$OUT" 2>&1
+if [ $? -ne 0 ]; then
+    cat "$OUT"
+    echo "Erro na execução do auto-tuner com $RANKS processos. Abortando."
+    exit 1
+fi
+cat "$OUT"
+
+if [ "$LAUNCH" = "1" ]; then
+    build=$(sed -n 's/^ Build: //p' "$OUT")
+    launch=$(sed -n 's/^ Launch: mpirun //p' "$OUT")
+    if [ -z "$build" ] || [ -z "$launch" ]; then
+        echo "O auto-tuner não recomendou nenhuma configuração. Abortando."
+        exit 1
+    fi
+    echo
+    echo "Executando a configuração recomendada: $launch"
+    # a linha Build já traz HYBRID=ON quando a recomendação usa threads
+    $build $MAKE_FLAGS > "$logfile" 2>&1 || { cat "$logfile"; exit 1; }
+    $MPIRUN $launch
+fi
@@ -0,0 +1,52 @@
+#include "include/k-means/k_means.h"
+
+// converts the binary dump of a DEBUG=ON run (kmeans.debug.bin) into the text report
+// (kmeans.debug.dat), comparing it with the reference values of the data set
+// usage: ./debug_converter.<WORKLOAD>.exe [dump file] [report file]
+int main(int argc, char* argv[]){
+    char* dump_name = (argc > 1) ? argv[1] : (char*)DEBUG_DUMP_FILE;
+    char* report_name = (argc > 2) ? argv[2] : (char*)DEBUG_REPORT_FILE;
+
+    points = (Points*) malloc(sizeof(Points));
+    points->cluster = (int*) malloc(N_POINTS * sizeof(int));
+    points->x = (coord_t*) malloc(N_POINTS * sizeof(coord_t));
+    points->y = (coord_t*) malloc(N_POINTS * sizeof(coord_t));
+
+    means = (Means*) malloc(sizeof(Means));
+    means->count = (int*) malloc(N_MEANS * sizeof(int));
+    means->x = (double*) malloc(N_MEANS * sizeof(double));
+    means->y = (double*) malloc(N_MEANS * sizeof(double));
+
+    points_cluster_verification = (int*) malloc(N_POINTS * sizeof(int));
+    means_verification = (mean*) malloc(N_MEANS * sizeof(mean));
+
+    // reference values
+    initialization();
+
+    FILE* file = fopen(dump_name, "rb");
+    if(file == NULL){
+        printf("Error when trying to open %s!\n", dump_name);
+        exit(-1);
+    }
+
+    debug_header header;
+    if(fread(&header, sizeof(debug_header), 1, file) != 1){exit(-1);}
+    if(memcmp(header.magic, DEBUG_MAGIC, 4) != 0 || header.n_points != N_POINTS || header.n_means != N_MEANS){
+        printf("Error: %s does not match workload %s!\n", dump_name, (char*)WORKLOAD);
+        exit(-1);
+    }
+    iteration_control = header.iterations;
+
+    if(fread(points->cluster, sizeof(int), N_POINTS, file) != (size_t)N_POINTS){exit(-1);}
+    if(fread(means->x, sizeof(double), N_MEANS, file) != (size_t)N_MEANS){exit(-1);}
+    if(fread(means->y, sizeof(double), N_MEANS, file) != (size_t)N_MEANS){exit(-1);}
+    if(fread(means->count, sizeof(int), N_MEANS, file) != (size_t)N_MEANS){exit(-1);}
+    fclose(file);
+
+    verification();
+    write_debug_report(report_name);
+    printf("%s written (verification %s)\n", report_name, passed_verification ? "PASSED" : "FAILED");
+
+    release_resources();
+    return 0;
+}
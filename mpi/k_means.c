@@ -1,46 +1,170 @@
 
 #include "include/k-means/k_means.h"
 #include<mpi.h>
+#include "include/common/phase_timers.h"
+#if defined(CHECKPOINT)
+#include <unistd.h>
+#endif
+#if defined(HYBRID)
+#include <omp.h>
+#endif
+#if defined(HYBRID) || defined(TUNE)
+#include <sched.h>
+#endif
 
 #define ROOT 0
 
+const phase_timer phases[] = {
+    {TIMER_LOAD, "load"},
+    {TIMER_DISTRIBUTION, "distribution"},
+    {TIMER_ASSIGN, "assign"},
+    {TIMER_ACCUMULATE, "local_accumulate"},
+    {TIMER_REDUCTION, "reduction"},
+    {TIMER_GATHER, "final_gather"}
+};
+
+#if defined(LOAD_BALANCING) && defined(SHARED_MEMORY)
+#error "LOAD_BALANCING moves points between ranks of different nodes, use it without SHARED_MEMORY"
+#endif
+
+#if defined(TUNE) && (defined(SHARED_MEMORY) || defined(LOAD_BALANCING) || defined(HIERARCHICAL_REDUCTION))
+#error "TUNE models the private copies and the flat reductions, use it without SHARED_MEMORY, LOAD_BALANCING and HIERARCHICAL_REDUCTION"
+#endif
+
 int main(int argc, char* argv[]){
+#if defined(HYBRID)
+    // only the master thread calls MPI, the OpenMP regions never do
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#else
     MPI_Init(&argc, &argv);
+#endif
 
     int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    // flags and timers on every rank (with SHARED_MEMORY only the first rank of each node
+    // goes through initialization())
+    setup_common();
+
+#if defined(TUNE)
+    tune_cores = tune_launch_cores(rank);
+#endif
+#if defined(HYBRID)
+    hybrid_pin_threads(rank);
+#endif
+
+#if defined(WORKLOAD_RUNTIME)
+    // data set sizes and the kernels specialized for them
+    select_workload(argc, argv);
+    select_kernels();
+#endif
+
+#if defined(ARENA)
+    // every array below and the per-rank copies of k_means() in one huge-page backed region
+    arena_create(arena_bytes());
+    if(rank == ROOT){
+        arena_report();
+    }
+#endif
 
     points = (Points*) malloc(sizeof(Points));
-    points->cluster = (int*) malloc(N_POINTS * sizeof(int));
-    points->x = (double*) malloc(N_POINTS * sizeof(double));
-    points->y = (double*) malloc(N_POINTS * sizeof(double));
-    
     means = (Means*) malloc(sizeof(Means));
-    means->count = (int*) malloc(N_MEANS * sizeof(int));
-    means->x = (double*) malloc(N_MEANS * sizeof(double));
-    means->y = (double*) malloc(N_MEANS * sizeof(double));
+#if defined(NODE_COMM)
+    node_setup();
+#endif
+#if defined(HIERARCHICAL_REDUCTION)
+    hierarchical_setup();
+#endif
+#if defined(SHARED_MEMORY)
+    // points and means shared by the ranks of each node, read by the node's first rank
+    shared_memory_setup();
+    if(timer_flag){timer_start(TIMER_LOAD);}
+    if(node_rank == 0){
+#if !defined(HASH_VERIFICATION)
+        points_cluster_verification = (int*) arena_alloc(N_POINTS * sizeof(int));
+#endif
+        means_verification = (mean*) arena_alloc(N_MEANS * sizeof(mean));
 
-    points_cluster_verification = (int*) malloc(N_POINTS * sizeof(int));
-    means_verification = (mean*) malloc(N_MEANS * sizeof(mean));
+        // initial values
+        initialization();
+    }
+    if(timer_flag){timer_stop(TIMER_LOAD);}
+    // the other ranks of the node wait here for the points
+    if(timer_flag){timer_start(TIMER_DISTRIBUTION);}
+    shared_memory_sync();
+    if(timer_flag){timer_stop(TIMER_DISTRIBUTION);}
+#else
+    points->cluster = (int*) arena_alloc(N_POINTS * sizeof(int));
+    points->x = (coord_t*) arena_alloc(N_POINTS * sizeof(coord_t));
+    points->y = (coord_t*) arena_alloc(N_POINTS * sizeof(coord_t));
+    
+    means->count = (int*) arena_alloc(N_MEANS * sizeof(int));
+    means->x = (double*) arena_alloc(N_MEANS * sizeof(double));
+    means->y = (double*) arena_alloc(N_MEANS * sizeof(double));
+
+#if !defined(HASH_VERIFICATION)
+    points_cluster_verification = (int*) arena_alloc(N_POINTS * sizeof(int));
+#endif
+    means_verification = (mean*) arena_alloc(N_MEANS * sizeof(mean));
 
 	// initial values
+    if(timer_flag){timer_start(TIMER_LOAD);}
 	initialization();
+    if(timer_flag){timer_stop(TIMER_LOAD);}
+#endif
+#if defined(TUNE)
+    // the data set only feeds the calibration, k_means() does not run
+    tune(rank);
+    release_resources();
+    MPI_Finalize();
+    return 0;
+#endif
     if(rank == ROOT){
         timer_start(TIMER_TOTAL); 
     } 
+    if(timer_flag){timer_start(TIMER_COMPUTATION);}
 	k_means(); 
+    if(timer_flag){timer_stop(TIMER_COMPUTATION);}
 
+    phase_timers_reduce(phases, sizeof(phases) / sizeof(phases[0]), ROOT);
+#if defined(ROOFLINE)
+    // after the run, so the probe does not disturb it
+    roofline_measure(rank);
+#endif
     if(rank == ROOT){ 
         timer_stop(TIMER_TOTAL);
 
         // checksum routine
         verification(); 
+        phase_timers_append(phases, sizeof(phases) / sizeof(phases[0]));
         // print results
         debug_results();	 
 
+        // fields of the structured report (KMEANS_REPORT_FILE)
+        int nprocs;
+        MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+        report_integer("n_points", N_POINTS);
+        report_integer("n_means", N_MEANS);
+        report_integer("ranks", nprocs);
+#if defined(HYBRID)
+        report_integer("threads", omp_get_max_threads());
+#else
+        report_integer("threads", 1);
+#endif
+        report_integer("iterations", iteration_control);
         execution_report((char*)"K-Means", (char*)WORKLOAD, timer_read(TIMER_TOTAL), passed_verification);
     }
     // freeing memory and stuff
+#if defined(HIERARCHICAL_REDUCTION)
+    hierarchical_release();
+#endif
+#if defined(SHARED_MEMORY)
+    debug_results_wait();
+    shared_memory_release();
+#endif
+#if defined(NODE_COMM)
+    node_release();
+#endif
     release_resources(); 
     MPI_Finalize();
 	return 0;
@@ -54,56 +178,216 @@ void k_means(){
     double *x_g = NULL;
     double *y_g = NULL;
     int *cluster_p = NULL; 
-    double *x_p = NULL;
-    double *y_p = NULL;
+    coord_t *x_p = NULL;
+    coord_t *y_p = NULL;
 
     int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     int nprocs;
     MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
 
-    count_g = (int*) calloc(N_MEANS, sizeof(int));
-    x_g = (double*) calloc(N_MEANS, sizeof(double));
-    y_g = (double*) calloc(N_MEANS, sizeof(double));
+#if defined(CHECKPOINT)
+    // the means, the clusters and iteration_control of the last checkpoint, if restarting
+    checkpoint_restore(rank);
+#endif
 
-    cluster_p = (int*) malloc(N_POINTS * sizeof(int));
-    x_p = (double*) malloc(N_POINTS * sizeof(double));
-    y_p = (double*) malloc(N_POINTS * sizeof(double));
+#if defined(HIERARCHICAL_REDUCTION)
+    // the rank accumulates straight into its block of the node's reduction window
+    hierarchical_block(1 + node_rank, &x_g, &y_g, &count_g);
+#else
+    count_g = (int*) arena_calloc(N_MEANS, sizeof(int));
+    x_g = (double*) arena_calloc(N_MEANS, sizeof(double));
+    y_g = (double*) arena_calloc(N_MEANS, sizeof(double));
+#endif
 
+#if defined(SHARED_MEMORY)
+    // no private copies: every rank works on its slice of the node-shared points
+    cluster_p = points->cluster;
+    x_p = points->x;
+    y_p = points->y;
+#else
+    if(timer_flag){timer_start(TIMER_DISTRIBUTION);}
+    cluster_p = (int*) arena_alloc(N_POINTS * sizeof(int));
+    x_p = (coord_t*) arena_alloc(N_POINTS * sizeof(coord_t));
+    y_p = (coord_t*) arena_alloc(N_POINTS * sizeof(coord_t));
+
+#if defined(HYBRID)
+    // first touch by the thread that will process each point: the static schedule over the
+    // rank's strided points gives thread t the same index range as this loop, so with a rank
+    // spanning several NUMA domains every slice stays on its thread's domain
+    #pragma omp parallel for schedule(static)
+    for(int i = 0; i < N_POINTS; i++){
+        cluster_p[i] = points->cluster[i];
+        x_p[i] = points->x[i];
+        y_p[i] = points->y[i];
+    }
+#else
     memcpy(cluster_p, points->cluster, N_POINTS * sizeof(int));
-    memcpy(x_p, points->x, N_POINTS * sizeof(double));
-    memcpy(y_p, points->y, N_POINTS * sizeof(double));
+    memcpy(x_p, points->x, N_POINTS * sizeof(coord_t));
+    memcpy(y_p, points->y, N_POINTS * sizeof(coord_t));
+#endif
+    if(timer_flag){timer_stop(TIMER_DISTRIBUTION);}
+#endif
+
+#if defined(CHECKPOINT) && !defined(SHARED_MEMORY) && !defined(LOAD_BALANCING)
+    // the MAX reduction at the end keeps each point's cluster from its owner because the other
+    // copies hold the data set's initial 0; restored clusters are reset to that on non-owned points
+    if(getenv("KMEANS_RESTART") != NULL){
+        for(int i = 0; i < N_POINTS; i++){
+            if(i % nprocs != rank){
+                cluster_p[i] = 0;
+            }
+        }
+    }
+#endif
+
+#if defined(LOAD_BALANCING)
+    balance_setup(nprocs);
+#endif
+
+#if defined(TRACE)
+    if(rank == ROOT){
+        trace_setup(N_MEANS);
+    }
+#endif
 
     int mod_aux = 1;
     while(mod_aux){
         modified = 0;
+#if defined(TRACE)
+        double trace_start = MPI_Wtime();
+        if(rank == ROOT){
+            for(int i = 0; i < N_MEANS; i++){
+                trace_save(i, means->x[i], means->y[i]);
+            }
+        }
+#endif
 
+        if(timer_flag){timer_start(TIMER_ASSIGN);}
+#if defined(LOAD_BALANCING)
+        double start = MPI_Wtime();
+        find_clusters(rank, nprocs, x_p, y_p, cluster_p);
+        balance_time += MPI_Wtime() - start;
+#else
         find_clusters(rank, nprocs, x_p, y_p, cluster_p);
+#endif
+        if(timer_flag){timer_stop(TIMER_ASSIGN);}
+#if defined(TRACE)
+        double trace_assigned = MPI_Wtime();
+#endif
 
         calculate_means(rank, nprocs, x_g, y_g, count_g, x_p, y_p, cluster_p);
 
         iteration_control++;
+#if defined(TRACE)
+        double trace_updated = MPI_Wtime();
+#endif
+        if(timer_flag){timer_start(TIMER_REDUCTION);}
         MPI_Allreduce(&modified, &mod_aux, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        if(timer_flag){timer_stop(TIMER_REDUCTION);}
+#if defined(LOAD_BALANCING)
+        if(mod_aux && iteration_control % BALANCE_INTERVAL == 0){
+            balance_points(nprocs, cluster_p);
+        }
+#endif
+#if defined(CHECKPOINT)
+        if(mod_aux && iteration_control % checkpoint_interval() == 0){
+            checkpoint_write(rank, nprocs, cluster_p);
+        }
+#endif
+#if defined(TRACE)
+        trace_iteration(rank, nprocs, trace_start, trace_assigned, trace_updated, x_p, y_p, cluster_p);
+#endif
+    }
+#if defined(TRACE)
+    if(rank == ROOT){
+#if defined(HYBRID)
+        trace_write(WORKLOAD, "mpi", N_POINTS, N_MEANS, nprocs, omp_get_max_threads());
+#else
+        trace_write(WORKLOAD, "mpi", N_POINTS, N_MEANS, nprocs, 1);
+#endif
+        trace_release();
     }
+#endif
+    if(timer_flag){timer_start(TIMER_GATHER);}
+#if defined(SHARED_MEMORY)
+    shared_memory_gather_clusters(rank, nprocs);
+#elif defined(LOAD_BALANCING)
+    // each rank only holds valid clusters for its own range
+    int* counts = (int*) malloc(nprocs * sizeof(int));
+    for(int r = 0; r < nprocs; r++){
+        counts[r] = balance_begin[r + 1] - balance_begin[r];
+    }
+    MPI_Gatherv(&cluster_p[balance_begin[rank]], counts[rank], MPI_INT,
+                points->cluster, counts, balance_begin, MPI_INT, ROOT, MPI_COMM_WORLD);
+    free(counts);
+    if(rank == ROOT){
+        printf(" Load balancing: %d migrations, %ld points moved\n", balance_migrations, balance_moved);
+    }
+    balance_release();
+    arena_free(y_p);
+    arena_free(x_p);
+    arena_free(cluster_p);
+#else
     MPI_Reduce(cluster_p, points->cluster, N_POINTS, MPI_INT, MPI_MAX, ROOT, MPI_COMM_WORLD);
+    arena_free(y_p);
+    arena_free(x_p);
+    arena_free(cluster_p);
+#endif
+    if(timer_flag){timer_stop(TIMER_GATHER);}
 
-    free(count_g);
-    free(x_g);
-    free(y_g);
-    free(y_p);
-    free(x_p);
-    free(cluster_p);
+#if !defined(HIERARCHICAL_REDUCTION)
+    arena_free(count_g);
+    arena_free(x_g);
+    arena_free(y_g);
+#endif
 }
 
-void find_clusters(int my_rank, int nprocs, double* x_p, double* y_p, int* cluster_p){
-    for(int i = my_rank; i < N_POINTS; i+=nprocs){
-        double min_dist = (x_p[i] - means->x[0]) * (x_p[i] - means->x[0])
-                        + (y_p[i] - means->y[0]) * (y_p[i] - means->y[0]);
+// points of a rank: every nprocs-th point of its private copy, with SHARED_MEMORY its
+// contiguous slice of the node-shared points, so no two ranks write the same cache lines, and
+// with LOAD_BALANCING the contiguous range balance_points() gave it
+static inline __attribute__((always_inline)) void rank_points(int points_count, int my_rank, int nprocs, int* begin, int* end, int* stride){
+#if defined(LOAD_BALANCING)
+    *begin = balance_begin[my_rank];
+    *end = balance_begin[my_rank + 1];
+    *stride = 1;
+    (void)points_count;
+    (void)nprocs;
+#elif defined(SHARED_MEMORY)
+    *begin = (int)((long)points_count * my_rank / nprocs);
+    *end = (int)((long)points_count * (my_rank + 1) / nprocs);
+    *stride = 1;
+#else
+    *begin = my_rank;
+    *end = points_count;
+    *stride = nprocs;
+#endif
+}
+
+// the kernels take the sizes as arguments and are always inlined, so every caller that passes
+// constants (a fixed WORKLOAD, or one of the per-class instances below) gets its own
+// specialization, while the runtime sizes go through the generic instance
+static inline __attribute__((always_inline)) void find_clusters_kernel(int points_count, int means_count, int my_rank, int nprocs, coord_t* x_p, coord_t* y_p, int* cluster_p){
+    int begin, end, stride;
+    rank_points(points_count, my_rank, nprocs, &begin, &end, &stride);
+
+    int changed = 0;
+#if defined(HYBRID)
+    // the rank's points are split among its threads
+    #pragma omp parallel for schedule(static) reduction(+:changed)
+#endif
+    for(int i = begin; i < end; i+=stride){
+        // widen the coordinates once per point (no-op unless COMPACT=ON)
+        double px = x_p[i];
+        double py = y_p[i];
+
+        double min_dist = (px - means->x[0]) * (px - means->x[0])
+                        + (py - means->y[0]) * (py - means->y[0]);
         int cluster_id = 0;
 
-        for(int j = 1; j < N_MEANS; j++){
-            double cur_dist = (x_p[i] - means->x[j]) * (x_p[i] - means->x[j])
-                            + (y_p[i] - means->y[j]) * (y_p[i] - means->y[j]);
+        for(int j = 1; j < means_count; j++){
+            double cur_dist = (px - means->x[j]) * (px - means->x[j])
+                            + (py - means->y[j]) * (py - means->y[j]);
             if(cur_dist < min_dist){
                 min_dist = cur_dist;
                 cluster_id = j;
@@ -112,33 +396,1019 @@ void find_clusters(int my_rank, int nprocs, double* x_p, double* y_p, int* clust
 
         if(cluster_p[i] != cluster_id){
             cluster_p[i] = cluster_id;
-            modified = 1;
+            changed++;
         }
     }
+    reassigned = changed;
+    if(changed){
+        modified = 1;
+    }
 }
 
-void calculate_means(int my_rank, int nprocs, double* x_, double* y_, int* count_, double* x_p, double* y_p, int* cluster_p){
-    for(int i = 0; i < N_MEANS; i++){
+static inline __attribute__((always_inline)) void calculate_means_kernel(int points_count, int means_count, int my_rank, int nprocs, double* x_, double* y_, int* count_, coord_t* x_p, coord_t* y_p, int* cluster_p){
+    if(timer_flag){timer_start(TIMER_ACCUMULATE);}
+    for(int i = 0; i < means_count; i++){
         count_[i] = 0;
         y_[i] = 0.0;
         x_[i] = 0.0;
     }
 
-    for(int i = my_rank; i < N_POINTS; i+=nprocs){
+    int begin, end, stride;
+    rank_points(points_count, my_rank, nprocs, &begin, &end, &stride);
+
+#if defined(HYBRID)
+    // each thread accumulates into private copies, combined before the collectives
+    // (sums of integer coordinates, so the order does not change the result)
+    #pragma omp parallel for schedule(static) reduction(+:x_[:means_count], y_[:means_count], count_[:means_count])
+#endif
+    for(int i = begin; i < end; i+=stride){
         int cluster = cluster_p[i];
         count_[cluster]++;
         x_[cluster] += x_p[i];
         y_[cluster] += y_p[i];
     }
+    if(timer_flag){timer_stop(TIMER_ACCUMULATE);}
 
-    MPI_Allreduce(x_, means->x, N_MEANS, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(y_, means->y, N_MEANS, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(count_, means->count, N_MEANS, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    // the reduction phase includes the new means, written once the sums are known
+    if(timer_flag){timer_start(TIMER_REDUCTION);}
+#if defined(HIERARCHICAL_REDUCTION)
+    // the totals are left in block 0 of the node's window, so the node-local broadcast is
+    // every rank reading them from there
+    hierarchical_reduce(means_count);
+    double *total_x, *total_y;
+    int* total_count;
+    hierarchical_block(0, &total_x, &total_y, &total_count);
 
-    for(int i = 0; i < N_MEANS; i++){
+#if defined(SHARED_MEMORY)
+    // every rank of the node publishes its share of the node-shared means
+    int means_begin = (int)((long)means_count * node_rank / node_size);
+    int means_end = (int)((long)means_count * (node_rank + 1) / node_size);
+#else
+    int means_begin = 0;
+    int means_end = means_count;
+#endif
+    for(int i = means_begin; i < means_end; i++){
+        means->count[i] = total_count[i];
+        means->x[i] = (total_count[i] > 0) ? total_x[i] / total_count[i] : total_x[i];
+        means->y[i] = (total_count[i] > 0) ? total_y[i] / total_count[i] : total_y[i];
+    }
+#if defined(SHARED_MEMORY)
+    shared_memory_sync();
+#endif
+#elif defined(SHARED_MEMORY)
+    MPI_Allreduce(MPI_IN_PLACE, x_, means_count, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, y_, means_count, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, count_, means_count, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+    // the node's first rank publishes the new means to the whole node (every rank is
+    // done reading them: it has entered the reductions above)
+    if(node_rank == 0){
+        for(int i = 0; i < means_count; i++){
+            means->count[i] = count_[i];
+            means->x[i] = (count_[i] > 0) ? x_[i] / count_[i] : x_[i];
+            means->y[i] = (count_[i] > 0) ? y_[i] / count_[i] : y_[i];
+        }
+    }
+    shared_memory_sync();
+#else
+    MPI_Allreduce(x_, means->x, means_count, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(y_, means->y, means_count, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(count_, means->count, means_count, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+    for(int i = 0; i < means_count; i++){
         if(means->count[i] > 0){
             means->x[i] /= means->count[i];
             means->y[i] /= means->count[i];
         }
     }
+#endif
+    if(timer_flag){timer_stop(TIMER_REDUCTION);}
+}
+
+#if defined(TRACE)
+// collective: the root records the iteration that just ended, with the points reassigned and
+// the SSE summed over the ranks, the slowest rank's phase times (the rest of the iteration is
+// the convergence check, the rebalance and the checkpoint) and the shifts of the means
+void trace_iteration(int rank, int nprocs, double start, double assigned, double updated, coord_t* x_p, coord_t* y_p, int* cluster_p){
+    int begin, end, stride;
+    rank_points(N_POINTS, rank, nprocs, &begin, &end, &stride);
+
+    double local[2] = {(double)reassigned, 0.0}, total[2];
+    for(int i = begin; i < end; i += stride){
+        double dx = x_p[i] - means->x[cluster_p[i]];
+        double dy = y_p[i] - means->y[cluster_p[i]];
+        local[1] += dx * dx + dy * dy;
+    }
+    double times[3] = {assigned - start, updated - assigned, MPI_Wtime() - updated}, slowest[3];
+    MPI_Reduce(local, total, 2, MPI_DOUBLE, MPI_SUM, ROOT, MPI_COMM_WORLD);
+    MPI_Reduce(times, slowest, 3, MPI_DOUBLE, MPI_MAX, ROOT, MPI_COMM_WORLD);
+
+    if(rank == ROOT){
+        trace_record* record = trace_next(iteration_control);
+        record->reassigned = (int)total[0];
+        record->sse = total[1];
+        record->assign_time = slowest[0];
+        record->update_time = slowest[1];
+        record->other_time = slowest[2];
+        for(int i = 0; i < N_MEANS; i++){
+            trace_shift(record, i, means->x[i], means->y[i]);
+        }
+    }
+}
+#endif
+
+#if defined(ROOFLINE)
+// collective: the peaks of every thread of every rank, probing at the same time on their share
+// of the node's stream arrays, and on the root the counts of the iterations over the slowest
+// rank's phases: assign computes a distance per point x mean, reading every point and the means
+// once per rank; local_accumulate adds up x and y of every point, reading the points and writing
+// the sums of every rank; reduction sums the ranks' sums and divides the means on every rank.
+// The means and sums of the ranks of a node share its last-level cache, and only reach memory
+// when they do not fit in it
+void roofline_measure(int rank){
+    int nprocs, node_size;
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+    MPI_Comm node;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+    MPI_Comm_size(node, &node_size);
+    MPI_Comm_free(&node);
+
+    double local[2] = {0.0, 0.0}, peak[2];
+    MPI_Barrier(MPI_COMM_WORLD);
+#if defined(HYBRID)
+    long length = roofline_stream_length() / ((long)node_size * omp_get_max_threads());
+    double flops = 0.0, bytes = 0.0;
+    #pragma omp parallel reduction(+:flops, bytes)
+    {
+        double thread_flops, thread_bytes;
+        roofline_probe(length, &thread_flops, &thread_bytes);
+        flops += thread_flops;
+        bytes += thread_bytes;
+    }
+    local[0] = flops;
+    local[1] = bytes;
+#else
+    roofline_probe(roofline_stream_length() / node_size, &local[0], &local[1]);
+#endif
+    MPI_Reduce(local, peak, 2, MPI_DOUBLE, MPI_SUM, ROOT, MPI_COMM_WORLD);
+    if(rank != ROOT){
+        return;
+    }
+    roofline_peak(peak[0], peak[1]);
+
+    double iterations = iteration_control;
+    double point_bytes = (double)N_POINTS * (2 * sizeof(coord_t) + sizeof(int));
+    double rank_mean_bytes = (double)N_MEANS * 2 * sizeof(double);
+    double rank_sum_bytes = (double)N_MEANS * (2 * sizeof(double) + sizeof(int));
+    double mean_bytes = roofline_memory_bytes(nprocs * rank_mean_bytes, node_size * rank_mean_bytes);
+    double sum_bytes = roofline_memory_bytes(nprocs * rank_sum_bytes, node_size * rank_sum_bytes);
+    roofline_phase("assign", iterations * DISTANCE_FLOPS * N_POINTS * N_MEANS,
+        iterations * (point_bytes + mean_bytes), phase_max[TIMER_ASSIGN]);
+    roofline_phase("local_accumulate", iterations * 2.0 * N_POINTS,
+        iterations * (point_bytes + sum_bytes), phase_max[TIMER_ACCUMULATE]);
+    roofline_phase("reduction", iterations * (nprocs - 1 + nprocs) * 2.0 * N_MEANS,
+        iterations * sum_bytes, phase_max[TIMER_REDUCTION]);
+}
+#endif
+
+#if defined(HYBRID)
+// binds each OpenMP thread of the rank to its own core among the ones the launcher gave the
+// rank (mpirun --map-by numa --bind-to numa: one rank and one thread team per NUMA domain),
+// unless OMP_PROC_BIND already asks the OpenMP runtime to do it
+void hybrid_pin_threads(int rank){
+    int n_threads = omp_get_max_threads();
+    if(getenv("OMP_PROC_BIND") == NULL){
+        cpu_set_t rank_set;
+        sched_getaffinity(0, sizeof(cpu_set_t), &rank_set);
+        int n_cores = CPU_COUNT(&rank_set);
+        int* cores = (int*) malloc(n_cores * sizeof(int));
+        for(int c = 0, n = 0; n < n_cores; c++){
+            if(CPU_ISSET(c, &rank_set)){
+                cores[n++] = c;
+            }
+        }
+
+        #pragma omp parallel
+        {
+            cpu_set_t thread_set;
+            CPU_ZERO(&thread_set);
+            CPU_SET(cores[omp_get_thread_num() % n_cores], &thread_set);
+            sched_setaffinity(0, sizeof(cpu_set_t), &thread_set);
+        }
+        free(cores);
+    }
+
+    int nprocs;
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+    if(rank == ROOT){
+        printf(" Hybrid mode: %d ranks x %d threads\n", nprocs, n_threads);
+    }
+}
+#endif
+
+#if defined(CHECKPOINT)
+// KMEANS_CHECKPOINT_INTERVAL iterations, or CHECKPOINT_INTERVAL
+int checkpoint_interval(){
+    char* interval = getenv("KMEANS_CHECKPOINT_INTERVAL");
+    int value = (interval != NULL) ? atoi(interval) : CHECKPOINT_INTERVAL;
+    return (value > 0) ? value : CHECKPOINT_INTERVAL;
+}
+
+// the meta file for rank < 0, the file of the rank otherwise
+void checkpoint_file_name(char* file_name, size_t size, int slot, int rank){
+    char* directory = getenv("KMEANS_CHECKPOINT_DIR");
+    if(directory == NULL){
+        directory = (char*)".";
+    }
+    if(rank < 0){
+        snprintf(file_name, size, "%s/checkpoint.%s.meta", directory, (char*)WORKLOAD);
+    }
+    else{
+        snprintf(file_name, size, "%s/checkpoint.%s.%d.%d.bin", directory, (char*)WORKLOAD, slot, rank);
+    }
+}
+
+// flushed to the disk before closing, so a committed checkpoint survives the node
+void checkpoint_close(FILE* file){
+    fflush(file);
+    fsync(fileno(file));
+    fclose(file);
+}
+
+// every rank writes its points' clusters (rank 0 also the means) in parallel, then the root
+// commits the checkpoint once all of them are on disk
+void checkpoint_write(int rank, int nprocs, int* cluster_p){
+    int slot = 1 - checkpoint_slot;
+    char file_name[512];
+
+    int begin, end, stride;
+    rank_points(N_POINTS, rank, nprocs, &begin, &end, &stride);
+    int count = (end > begin) ? (end - begin + stride - 1) / stride : 0;
+
+    checkpoint_file_name(file_name, sizeof(file_name), slot, rank);
+    FILE* file = fopen(file_name, "wb");
+    if(!file){
+        printf("Error when trying to write the checkpoint %s!\n", file_name);
+        exit(-1);
+    }
+    checkpoint_rank_header header;
+    memset(&header, 0, sizeof(checkpoint_rank_header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+    header.rank = rank;
+    header.iterations = iteration_control;
+    header.begin = begin;
+    header.end = end;
+    header.stride = stride;
+    fwrite(&header, sizeof(checkpoint_rank_header), 1, file);
+
+    if(rank == ROOT){
+        fwrite(means->x, sizeof(double), N_MEANS, file);
+        fwrite(means->y, sizeof(double), N_MEANS, file);
+        fwrite(means->count, sizeof(int), N_MEANS, file);
+    }
+    if(stride == 1){
+        fwrite(&cluster_p[begin], sizeof(int), count, file);
+    }
+    else{
+        int* clusters = (int*) malloc(count * sizeof(int));
+        for(int i = begin, n = 0; i < end; i += stride){
+            clusters[n++] = cluster_p[i];
+        }
+        fwrite(clusters, sizeof(int), count, file);
+        free(clusters);
+    }
+    checkpoint_close(file);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    if(rank == ROOT){
+        checkpoint_header meta;
+        memset(&meta, 0, sizeof(checkpoint_header));
+        memcpy(meta.magic, CHECKPOINT_MAGIC, 4);
+        for(int c = 0; c < 3 && ((char*)WORKLOAD)[c] != '\0'; c++){
+            meta.workload[c] = ((char*)WORKLOAD)[c];
+        }
+        meta.n_points = N_POINTS;
+        meta.n_means = N_MEANS;
+        meta.nprocs = nprocs;
+        meta.slot = slot;
+        meta.iterations = iteration_control;
+
+        // written aside and renamed, so the meta file is always a complete one
+        char meta_name[512], temporary_name[520];
+        checkpoint_file_name(meta_name, sizeof(meta_name), slot, -1);
+        snprintf(temporary_name, sizeof(temporary_name), "%s.tmp", meta_name);
+        FILE* meta_file = fopen(temporary_name, "wb");
+        if(!meta_file){
+            printf("Error when trying to write the checkpoint %s!\n", temporary_name);
+            exit(-1);
+        }
+        fwrite(&meta, sizeof(checkpoint_header), 1, meta_file);
+        checkpoint_close(meta_file);
+        if(rename(temporary_name, meta_name) != 0){
+            printf("Error when trying to write the checkpoint %s!\n", meta_name);
+            exit(-1);
+        }
+    }
+    checkpoint_slot = slot;
+}
+
+// with KMEANS_RESTART set, loads the last committed checkpoint: the means, iteration_control
+// and the clusters of every point, gathered from the files of all the ranks that wrote it, so
+// the run can go on with any number of ranks (the directory must be visible to all of them)
+void checkpoint_restore(int rank){
+    if(getenv("KMEANS_RESTART") == NULL){
+        return;
+    }
+    char file_name[512];
+    checkpoint_file_name(file_name, sizeof(file_name), 0, -1);
+    FILE* file = fopen(file_name, "rb");
+    checkpoint_header meta;
+    if(!file || fread(&meta, sizeof(checkpoint_header), 1, file) != 1
+       || memcmp(meta.magic, CHECKPOINT_MAGIC, 4) != 0 || meta.n_points != N_POINTS || meta.n_means != N_MEANS){
+        printf("Error when trying to read the checkpoint %s!\n", file_name);
+        exit(-1);
+    }
+    fclose(file);
+    checkpoint_slot = meta.slot;
+    iteration_control = meta.iterations;
+
+#if defined(SHARED_MEMORY)
+    // the node's first rank fills the node-shared points and means
+    if(node_rank == 0){
+#endif
+    for(int r = 0; r < meta.nprocs; r++){
+        checkpoint_file_name(file_name, sizeof(file_name), meta.slot, r);
+        file = fopen(file_name, "rb");
+        checkpoint_rank_header header;
+        int valid = (file != NULL) && fread(&header, sizeof(checkpoint_rank_header), 1, file) == 1
+                 && memcmp(header.magic, CHECKPOINT_MAGIC, 4) == 0 && header.iterations == meta.iterations
+                 && header.rank == r && header.begin >= 0 && header.end <= N_POINTS && header.stride > 0;
+        if(valid && r == 0){
+            valid = fread(means->x, sizeof(double), N_MEANS, file) == (size_t)N_MEANS
+                 && fread(means->y, sizeof(double), N_MEANS, file) == (size_t)N_MEANS
+                 && fread(means->count, sizeof(int), N_MEANS, file) == (size_t)N_MEANS;
+        }
+        if(valid && header.end > header.begin){
+            int count = (header.end - header.begin + header.stride - 1) / header.stride;
+            int* clusters = (int*) malloc(count * sizeof(int));
+            valid = fread(clusters, sizeof(int), count, file) == (size_t)count;
+            for(int i = header.begin, n = 0; valid && i < header.end; i += header.stride){
+                points->cluster[i] = clusters[n++];
+            }
+            free(clusters);
+        }
+        if(!valid){
+            printf("Error when trying to read the checkpoint %s!\n", file_name);
+            exit(-1);
+        }
+        fclose(file);
+    }
+#if defined(SHARED_MEMORY)
+    }
+    shared_memory_sync();
+#endif
+
+    if(rank == ROOT){
+        printf(" Restart: iteration %d, checkpoint written by %d ranks\n", meta.iterations, meta.nprocs);
+    }
+}
+#endif
+
+#if defined(LOAD_BALANCING)
+// equal contiguous ranges to start with
+void balance_setup(int nprocs){
+    balance_begin = (int*) malloc((nprocs + 1) * sizeof(int));
+    for(int r = 0; r <= nprocs; r++){
+        balance_begin[r] = (int)((long)N_POINTS * r / nprocs);
+    }
+    balance_time = 0.0;
+    balance_migrations = 0;
+    balance_moved = 0;
+}
+
+// gives every rank a share of the points proportional to the rate it processed its current
+// range at, when the slowest rank is more than BALANCE_THRESHOLD above the average; every rank
+// computes the same ranges from the gathered times, then the clusters of the old ranges are
+// gathered everywhere, so each rank has the assignments of its new range (the coordinates are
+// already replicated on every rank)
+void balance_points(int nprocs, int* cluster_p){
+    double* times = (double*) malloc(nprocs * sizeof(double));
+    MPI_Allgather(&balance_time, 1, MPI_DOUBLE, times, 1, MPI_DOUBLE, MPI_COMM_WORLD);
+    balance_time = 0.0;
+
+    double max_time = 0.0, sum_time = 0.0;
+    for(int r = 0; r < nprocs; r++){
+        sum_time += times[r];
+        max_time = (times[r] > max_time) ? times[r] : max_time;
+    }
+    if(sum_time <= 0.0 || max_time <= BALANCE_THRESHOLD * sum_time / nprocs){
+        free(times);
+        return;
+    }
+
+    // points per second; a rank with no points (or no measurable time) gets the average rate
+    double* rates = (double*) malloc(nprocs * sizeof(double));
+    double sum_rate = 0.0;
+    int n_rates = 0;
+    for(int r = 0; r < nprocs; r++){
+        int n = balance_begin[r + 1] - balance_begin[r];
+        rates[r] = (n > 0 && times[r] > 0.0) ? n / times[r] : 0.0;
+        if(rates[r] > 0.0){
+            sum_rate += rates[r];
+            n_rates++;
+        }
+    }
+    if(n_rates == 0){
+        free(rates);
+        free(times);
+        return;
+    }
+    for(int r = 0; r < nprocs; r++){
+        if(rates[r] == 0.0){
+            rates[r] = sum_rate / n_rates;
+        }
+    }
+    sum_rate = 0.0;
+    for(int r = 0; r < nprocs; r++){
+        sum_rate += rates[r];
+    }
+
+    int* old_begin = (int*) malloc((nprocs + 1) * sizeof(int));
+    memcpy(old_begin, balance_begin, (nprocs + 1) * sizeof(int));
+    double cumulative = 0.0;
+    for(int r = 1; r < nprocs; r++){
+        cumulative += rates[r - 1];
+        balance_begin[r] = (int)(N_POINTS * (cumulative / sum_rate));
+    }
+
+    // migration of the assignment state
+    int* counts = (int*) malloc(nprocs * sizeof(int));
+    for(int r = 0; r < nprocs; r++){
+        counts[r] = old_begin[r + 1] - old_begin[r];
+    }
+    MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, cluster_p, counts, old_begin, MPI_INT, MPI_COMM_WORLD);
+
+    for(int r = 0; r < nprocs; r++){
+        int kept_begin = (old_begin[r] > balance_begin[r]) ? old_begin[r] : balance_begin[r];
+        int kept_end = (old_begin[r + 1] < balance_begin[r + 1]) ? old_begin[r + 1] : balance_begin[r + 1];
+        int kept = (kept_end > kept_begin) ? kept_end - kept_begin : 0;
+        balance_moved += balance_begin[r + 1] - balance_begin[r] - kept;
+    }
+    balance_migrations++;
+
+    free(counts);
+    free(old_begin);
+    free(rates);
+    free(times);
+}
+
+void balance_release(){
+    free(balance_begin);
+}
+#endif
+
+#if defined(NODE_COMM)
+// the ranks that can share memory, in world rank order (so ROOT is the first rank of its node)
+void node_setup(){
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+}
+
+void node_release(){
+    MPI_Comm_free(&node_comm);
+}
+#endif
+
+#if defined(HIERARCHICAL_REDUCTION)
+// a window with one block of sums per rank of the node plus one for the node's totals, and a
+// communicator with the first rank of every node for the inter-node step
+void hierarchical_setup(){
+    MPI_Comm_split(MPI_COMM_WORLD, (node_rank == 0) ? 0 : MPI_UNDEFINED, 0, &leader_comm);
+
+    // sums of x and y back to back, so the leaders reduce both in one call, then the counts
+    reduction_block_size = arena_size(2 * N_MEANS * sizeof(double)) + arena_size(N_MEANS * sizeof(int));
+    size_t total = (size_t)(node_size + 1) * reduction_block_size;
+
+    MPI_Win_allocate_shared((node_rank == 0) ? (MPI_Aint)total : 0, 1, MPI_INFO_NULL, node_comm, &reduction_base, &reduction_window);
+    MPI_Aint size;
+    int displacement_unit;
+    MPI_Win_shared_query(reduction_window, 0, &size, &displacement_unit, &reduction_base);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, reduction_window);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if(rank == ROOT){
+        int n_nodes;
+        MPI_Comm_size(leader_comm, &n_nodes);
+        printf(" Hierarchical reduction: %d nodes, %d ranks per node, %.1f MB per node\n", n_nodes, node_size, total / (1024.0 * 1024.0));
+    }
+}
+
+void hierarchical_block(int block, double** x_, double** y_, int** count_){
+    char* base = reduction_base + block * reduction_block_size;
+    *x_ = (double*) base;
+    *y_ = *x_ + N_MEANS;
+    *count_ = (int*)(base + arena_size(2 * N_MEANS * sizeof(double)));
+}
+
+void hierarchical_sync(){
+    MPI_Win_sync(reduction_window);
+    MPI_Barrier(node_comm);
+    MPI_Win_sync(reduction_window);
+}
+
+// node-local reduce (every rank adds up its share of the means over the blocks of the node),
+// then the inter-node Allreduce among the leaders; the totals end up in block 0 of every node
+void hierarchical_reduce(int means_count){
+    hierarchical_sync();
+
+    double *total_x, *total_y;
+    int* total_count;
+    hierarchical_block(0, &total_x, &total_y, &total_count);
+    int begin = (int)((long)means_count * node_rank / node_size);
+    int end = (int)((long)means_count * (node_rank + 1) / node_size);
+    for(int i = begin; i < end; i++){
+        total_count[i] = 0;
+        total_x[i] = 0.0;
+        total_y[i] = 0.0;
+    }
+    for(int r = 0; r < node_size; r++){
+        double *x_, *y_;
+        int* count_;
+        hierarchical_block(1 + r, &x_, &y_, &count_);
+        for(int i = begin; i < end; i++){
+            total_count[i] += count_[i];
+            total_x[i] += x_[i];
+            total_y[i] += y_[i];
+        }
+    }
+    hierarchical_sync();
+
+    if(leader_comm != MPI_COMM_NULL){
+        MPI_Allreduce(MPI_IN_PLACE, total_x, 2 * means_count, MPI_DOUBLE, MPI_SUM, leader_comm);
+        MPI_Allreduce(MPI_IN_PLACE, total_count, means_count, MPI_INT, MPI_SUM, leader_comm);
+    }
+    hierarchical_sync();
+}
+
+void hierarchical_release(){
+    MPI_Win_unlock_all(reduction_window);
+    MPI_Win_free(&reduction_window);
+    if(leader_comm != MPI_COMM_NULL){
+        MPI_Comm_free(&leader_comm);
+    }
+}
+#endif
+
+#if defined(SHARED_MEMORY)
+// one copy per node of the points and the means, in a window allocated by the node's first
+// rank and mapped by the others; every rank keeps it locked for passive access until the end
+void shared_memory_setup(){
+
+    // doubles first, every array on its own cache lines
+    size_t offset_means_x = 0;
+    size_t offset_means_y = offset_means_x + arena_size(N_MEANS * sizeof(double));
+    size_t offset_means_count = offset_means_y + arena_size(N_MEANS * sizeof(double));
+    size_t offset_x = offset_means_count + arena_size(N_MEANS * sizeof(int));
+    size_t offset_y = offset_x + arena_size(N_POINTS * sizeof(coord_t));
+    size_t offset_cluster = offset_y + arena_size(N_POINTS * sizeof(coord_t));
+    size_t total = offset_cluster + arena_size(N_POINTS * sizeof(int));
+
+    char* base;
+    MPI_Win_allocate_shared((node_rank == 0) ? (MPI_Aint)total : 0, 1, MPI_INFO_NULL, node_comm, &base, &node_window);
+    MPI_Aint size;
+    int displacement_unit;
+    MPI_Win_shared_query(node_window, 0, &size, &displacement_unit, &base);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, node_window);
+
+    means->x = (double*)(base + offset_means_x);
+    means->y = (double*)(base + offset_means_y);
+    means->count = (int*)(base + offset_means_count);
+    points->x = (coord_t*)(base + offset_x);
+    points->y = (coord_t*)(base + offset_y);
+    points->cluster = (int*)(base + offset_cluster);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if(rank == ROOT){
+        printf(" Shared memory: %d ranks per node, %.1f MB per node\n", node_size, total / (1024.0 * 1024.0));
+    }
+}
+
+// makes the stores of every rank of the node visible to the others
+void shared_memory_sync(){
+    MPI_Win_sync(node_window);
+    MPI_Barrier(node_comm);
+    MPI_Win_sync(node_window);
+}
+
+// the root's node already sees the slices of its ranks, the ranks of the other nodes send theirs
+void shared_memory_gather_clusters(int rank, int nprocs){
+    int begin, end, stride;
+    rank_points(N_POINTS, rank, nprocs, &begin, &end, &stride);
+
+    int leader = rank;
+    MPI_Bcast(&leader, 1, MPI_INT, 0, node_comm);
+    int count = (leader == ROOT) ? 0 : end - begin;
+
+    int* counts = NULL;
+    int* displacements = NULL;
+    if(rank == ROOT){
+        counts = (int*) malloc(nprocs * sizeof(int));
+        displacements = (int*) malloc(nprocs * sizeof(int));
+        for(int r = 0; r < nprocs; r++){
+            rank_points(N_POINTS, r, nprocs, &displacements[r], &end, &stride);
+        }
+    }
+    MPI_Gather(&count, 1, MPI_INT, counts, 1, MPI_INT, ROOT, MPI_COMM_WORLD);
+    MPI_Gatherv((rank == ROOT) ? MPI_IN_PLACE : &points->cluster[begin], count, MPI_INT,
+                points->cluster, counts, displacements, MPI_INT, ROOT, MPI_COMM_WORLD);
+    free(counts);
+    free(displacements);
+}
+
+void shared_memory_release(){
+    MPI_Win_unlock_all(node_window);
+    MPI_Win_free(&node_window);
+    means->x = NULL;
+    means->y = NULL;
+    means->count = NULL;
+    points->x = NULL;
+    points->y = NULL;
+    points->cluster = NULL;
+}
+#endif
+
+#if defined(ARENA)
+// size of the arena: the points and means, their per-rank copies and the verification
+// arrays, each rounded to the arena alignment
+size_t arena_bytes(){
+    size_t bytes = 2 * (arena_size(N_POINTS * sizeof(int)) + 2 * arena_size(N_POINTS * sizeof(coord_t)));
+    bytes += 2 * (arena_size(N_MEANS * sizeof(int)) + 2 * arena_size(N_MEANS * sizeof(double)));
+    bytes += arena_size(N_MEANS * sizeof(mean));
+#if !defined(HASH_VERIFICATION)
+    bytes += arena_size(N_POINTS * sizeof(int));
+#endif
+    return bytes;
+}
+#endif
+
+#if defined(WORKLOAD_RUNTIME)
+typedef struct{
+    const char* name;
+    int n_points;
+    int n_means;
+    void (*find_clusters)(int, int, coord_t*, coord_t*, int*);
+    void (*calculate_means)(int, int, double*, double*, int*, coord_t*, coord_t*, int*);
+} kernel_set;
+
+#define KERNEL_SET(class_, points_count, means_count) \
+    void find_clusters_##class_(int my_rank, int nprocs, coord_t* x_p, coord_t* y_p, int* cluster_p){ \
+        find_clusters_kernel(points_count, means_count, my_rank, nprocs, x_p, y_p, cluster_p);} \
+    void calculate_means_##class_(int my_rank, int nprocs, double* x_, double* y_, int* count_, coord_t* x_p, coord_t* y_p, int* cluster_p){ \
+        calculate_means_kernel(points_count, means_count, my_rank, nprocs, x_, y_, count_, x_p, y_p, cluster_p);}
+
+KERNEL_SET(A, 10, 2)
+KERNEL_SET(B, 1000, 10)
+KERNEL_SET(C, 10000, 250)
+KERNEL_SET(D, 100000, 1000)
+KERNEL_SET(E, 250000, 2500)
+KERNEL_SET(F, 500000, 5000)
+KERNEL_SET(G, 1000000, 10000)
+KERNEL_SET(H, 5000000, 50000)
+KERNEL_SET(generic, N_POINTS, N_MEANS)
+
+const kernel_set kernel_sets[] = {
+    {"A", 10, 2, find_clusters_A, calculate_means_A},
+    {"B", 1000, 10, find_clusters_B, calculate_means_B},
+    {"C", 10000, 250, find_clusters_C, calculate_means_C},
+    {"D", 100000, 1000, find_clusters_D, calculate_means_D},
+    {"E", 250000, 2500, find_clusters_E, calculate_means_E},
+    {"F", 500000, 5000, find_clusters_F, calculate_means_F},
+    {"G", 1000000, 10000, find_clusters_G, calculate_means_G},
+    {"H", 5000000, 50000, find_clusters_H, calculate_means_H}
+};
+const kernel_set kernel_generic = {"generic", 0, 0, find_clusters_generic, calculate_means_generic};
+const kernel_set* kernels = &kernel_generic;
+
+// picks the instance whose sizes match the data set
+void select_kernels(){
+    kernels = &kernel_generic;
+    for(int i = 0; i < (int)(sizeof(kernel_sets) / sizeof(kernel_sets[0])); i++){
+        if(kernel_sets[i].n_points == N_POINTS && kernel_sets[i].n_means == N_MEANS){
+            kernels = &kernel_sets[i];
+        }
+    }
+    // KMEANS_KERNELS=generic keeps the generic instance (the tuner may recommend it)
+    char* choice = getenv("KMEANS_KERNELS");
+    if(choice != NULL && strcmp(choice, "generic") == 0){
+        kernels = &kernel_generic;
+    }
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if(rank == ROOT){
+        printf(" Workload %s: %d points, %d means, %s kernels\n", (char*)WORKLOAD, N_POINTS, N_MEANS, kernels->name);
+    }
+}
+#endif
+
+void find_clusters(int my_rank, int nprocs, coord_t* x_p, coord_t* y_p, int* cluster_p){
+#if defined(WORKLOAD_RUNTIME)
+    kernels->find_clusters(my_rank, nprocs, x_p, y_p, cluster_p);
+#else
+    find_clusters_kernel(N_POINTS, N_MEANS, my_rank, nprocs, x_p, y_p, cluster_p);
+#endif
+}
+
+void calculate_means(int my_rank, int nprocs, double* x_, double* y_, int* count_, coord_t* x_p, coord_t* y_p, int* cluster_p){
+#if defined(WORKLOAD_RUNTIME)
+    kernels->calculate_means(my_rank, nprocs, x_, y_, count_, x_p, y_p, cluster_p);
+#else
+    calculate_means_kernel(N_POINTS, N_MEANS, my_rank, nprocs, x_, y_, count_, x_p, y_p, cluster_p);
+#endif
+}
+
+#if defined(TUNE)
+// the kernel with sizes the compiler cannot see, as the generic instance of k_means_runtime
+void tune_find_clusters_generic(int my_rank, int nprocs, coord_t* x_p, coord_t* y_p, int* cluster_p){
+#if defined(WORKLOAD_RUNTIME)
+    kernel_generic.find_clusters(my_rank, nprocs, x_p, y_p, cluster_p);
+#else
+    volatile int sizes[2] = {N_POINTS, N_MEANS};
+    find_clusters_kernel(sizes[0], sizes[1], my_rank, nprocs, x_p, y_p, cluster_p);
+#endif
+}
+
+// the powers of two below max, then max
+int tune_counts(int max, int* counts){
+    int n = 0;
+    for(int count = 1; count < max && n < TUNE_MAX_COUNTS - 1; count *= 2){
+        counts[n++] = count;
+    }
+    counts[n++] = max;
+    return n;
+}
+
+// collectives of an iteration: the sums of x and y (doubles), of the counts (ints) and the
+// convergence flag, each costing alpha + beta * bytes
+double tune_collectives_time(double alpha, double beta){
+    return 4.0 * alpha + beta * (N_MEANS * (2.0 * sizeof(double) + sizeof(int)) + sizeof(int));
+}
+
+// MPI_Allreduce among the first ranks of the launch, from one double to N_MEANS doubles, each
+// size timed on the slowest rank; the root fits alpha + beta * bytes by least squares
+void tune_collectives(int rank, int ranks, double* alpha, double* beta){
+    MPI_Comm comm;
+    MPI_Comm_split(MPI_COMM_WORLD, (rank < ranks) ? 0 : MPI_UNDEFINED, rank, &comm);
+    if(comm == MPI_COMM_NULL){
+        return;
+    }
+    double* send = (double*) calloc(N_MEANS, sizeof(double));
+    double* receive = (double*) calloc(N_MEANS, sizeof(double));
+    if(send == NULL || receive == NULL){
+        printf("Error when trying to allocate the tuning buffers!\n");
+        exit(-1);
+    }
+    double n = 0.0, sum_x = 0.0, sum_y = 0.0, sum_xx = 0.0, sum_xy = 0.0;
+    for(int count = 1; ; count = (count * 4 < N_MEANS) ? count * 4 : N_MEANS){
+        MPI_Allreduce(send, receive, count, MPI_DOUBLE, MPI_SUM, comm);
+        MPI_Barrier(comm);
+        double start = MPI_Wtime();
+        for(int r = 0; r < TUNE_REPETITIONS; r++){
+            MPI_Allreduce(send, receive, count, MPI_DOUBLE, MPI_SUM, comm);
+        }
+        double elapsed = (MPI_Wtime() - start) / TUNE_REPETITIONS, slowest;
+        MPI_Allreduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, comm);
+        double bytes = (double)count * sizeof(double);
+        n += 1.0;
+        sum_x += bytes;
+        sum_y += slowest;
+        sum_xx += bytes * bytes;
+        sum_xy += bytes * slowest;
+        if(count >= N_MEANS){
+            break;
+        }
+    }
+    double denominator = n * sum_xx - sum_x * sum_x;
+    *beta = (denominator > 0.0) ? (n * sum_xy - sum_x * sum_y) / denominator : 0.0;
+    *beta = (*beta > 0.0) ? *beta : 0.0;
+    *alpha = (sum_y - *beta * sum_x) / n;
+    *alpha = (*alpha > 0.0) ? *alpha : 0.0;
+    free(send);
+    free(receive);
+    MPI_Comm_free(&comm);
+}
+
+// cores the launch gave the ranks: the union of the affinity masks of the ranks of each node
+// (taken before hybrid_pin_threads() narrows them), summed over the nodes
+int tune_launch_cores(int rank){
+    MPI_Comm node;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+    int node_rank;
+    MPI_Comm_rank(node, &node_rank);
+    cpu_set_t rank_set, node_set;
+    sched_getaffinity(0, sizeof(cpu_set_t), &rank_set);
+    MPI_Allreduce(&rank_set, &node_set, sizeof(cpu_set_t), MPI_UNSIGNED_CHAR, MPI_BOR, node);
+    MPI_Comm_free(&node);
+    int node_cores = (node_rank == 0) ? CPU_COUNT(&node_set) : 0, cores;
+    MPI_Allreduce(&node_cores, &cores, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    return cores;
+}
+
+// calibrated iterations of the kernel and calculate_means() on the data set split among the
+// first active ranks of the launch (so they share the memory bandwidth as in a run, without
+// more threads than cores); the other ranks only join the reductions of calculate_means(),
+// where they wait as at a barrier. The slowest rank's seconds per point x mean in the kernel
+// and per point in the local accumulation of calculate_means() (its TIMER_ACCUMULATE share)
+void tune_compute(int rank, int active, void (*kernel)(int, int, coord_t*, coord_t*, int*), double* x_g, double* y_g, int* count_g, double* per_pair, double* per_point){
+    char* value = getenv("KMEANS_TUNE_TIME");
+    double min_time = (value != NULL && atof(value) > 0.0) ? atof(value) : TUNE_TIME;
+    // an idle rank starts past the last point, so it has none
+    int my_rank = (rank < active) ? rank : N_POINTS;
+
+    double find_time = 0.0, elapsed = 0.0;
+    double accumulated = timer_read(TIMER_ACCUMULATE);
+    int iterations = 0;
+    MPI_Barrier(MPI_COMM_WORLD);
+    while(iterations < TUNE_ITERATIONS || (elapsed < min_time && iterations < TUNE_MAX_ITERATIONS)){
+        double start = MPI_Wtime();
+        if(rank < active){
+            kernel(my_rank, active, points->x, points->y, points->cluster);
+        }
+        find_time += MPI_Wtime() - start;
+        // the reductions do not wait for the slowest kernel
+        MPI_Barrier(MPI_COMM_WORLD);
+        calculate_means(my_rank, active, x_g, y_g, count_g, points->x, points->y, points->cluster);
+        iterations++;
+        // every rank takes the same decision to go on
+        double spent = find_time + timer_read(TIMER_ACCUMULATE) - accumulated;
+        MPI_Allreduce(&spent, &elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    }
+
+    double local[2] = {0.0, 0.0}, slowest[2];
+    if(rank < active){
+        int begin, end, stride;
+        rank_points(N_POINTS, my_rank, active, &begin, &end, &stride);
+        double rank_count = (end > begin) ? (double)((end - begin + stride - 1) / stride) : 1.0;
+        local[0] = find_time / iterations / (rank_count * N_MEANS);
+        local[1] = (timer_read(TIMER_ACCUMULATE) - accumulated) / iterations / rank_count;
+    }
+    MPI_Allreduce(local, slowest, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    *per_pair = slowest[0];
+    *per_point = slowest[1];
+}
+
+// scaling auto-tuner: measures the kernels (the build's and the generic one) with each thread
+// count t on floor(cores / t) of the launch's ranks, so the cores the launch was given are all
+// busy but never oversubscribed, and the reductions among each rank count, then predicts the
+// time of an iteration with p ranks and t threads (p x t up to the cores) as
+//   per_pair(t, kernel) * ceil(N / p) * K + per_point(t) * ceil(N / p) + collectives(p)
+// and prints the configurations, the fastest one and how to build and launch it
+void tune(int rank){
+    int nprocs;
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+    int rank_counts[TUNE_MAX_COUNTS], thread_counts[TUNE_MAX_COUNTS];
+    int n_ranks = tune_counts(nprocs, rank_counts);
+#if defined(HYBRID)
+    int max_threads = omp_get_max_threads();
+#else
+    int max_threads = 1;
+#endif
+    int n_threads = tune_counts(max_threads, thread_counts);
+
+    const char* kernel_names[2] = {"specialized", "generic"};
+    int n_kernels = 2;
+#if defined(WORKLOAD_RUNTIME)
+    if(kernels == &kernel_generic){
+        kernel_names[0] = "generic";
+        n_kernels = 1;
+    }
+#endif
+
+    // more ranks than cores only time the oversubscription
+    while(n_ranks > 1 && rank_counts[n_ranks - 1] > tune_cores){
+        n_ranks--;
+    }
+    double alpha[TUNE_MAX_COUNTS], beta[TUNE_MAX_COUNTS];
+    for(int r = 0; r < n_ranks; r++){
+        tune_collectives(rank, rank_counts[r], &alpha[r], &beta[r]);
+    }
+
+    int* count_g = (int*) calloc(N_MEANS, sizeof(int));
+    double* x_g = (double*) calloc(N_MEANS, sizeof(double));
+    double* y_g = (double*) calloc(N_MEANS, sizeof(double));
+    if(count_g == NULL || x_g == NULL || y_g == NULL){
+        printf("Error when trying to allocate the tuning buffers!\n");
+        exit(-1);
+    }
+    // calculate_means() times its local accumulation under TIMER_ACCUMULATE
+    timer_flag = 1;
+    double per_pair[TUNE_MAX_COUNTS][2], per_point[TUNE_MAX_COUNTS], unused;
+    int active[TUNE_MAX_COUNTS];
+    for(int t = 0; t < n_threads; t++){
+#if defined(HYBRID)
+        omp_set_num_threads(thread_counts[t]);
+#endif
+        active[t] = tune_cores / thread_counts[t];
+        active[t] = (active[t] < 1) ? 1 : (active[t] > nprocs) ? nprocs : active[t];
+        tune_compute(rank, active[t], find_clusters, x_g, y_g, count_g, &per_pair[t][0], &per_point[t]);
+        if(n_kernels > 1){
+            tune_compute(rank, active[t], tune_find_clusters_generic, x_g, y_g, count_g, &per_pair[t][1], &unused);
+        }
+    }
+#if defined(HYBRID)
+    omp_set_num_threads(max_threads);
+#endif
+    free(count_g);
+    free(x_g);
+    free(y_g);
+
+    if(rank != ROOT){
+        return;
+    }
+    printf(" Tuning %s: %d points, %d means, up to %d ranks x %d threads on %d cores\n", (char*)WORKLOAD, N_POINTS, N_MEANS, nprocs, max_threads, tune_cores);
+    printf(" Reductions (alpha + beta * bytes):\n");
+    for(int r = 0; r < n_ranks; r++){
+        printf("   %6d ranks: %10.3f us + %8.4f ns/B\n", rank_counts[r], alpha[r] * 1.0e6, beta[r] * 1.0e9);
+    }
+    printf(" Compute (ns per point x mean, ns per point in calculate_means):\n");
+    for(int t = 0; t < n_threads; t++){
+        printf("   %6d threads on %6d ranks:", thread_counts[t], active[t]);
+        for(int k = 0; k < n_kernels; k++){
+            printf(" %s %.4f", kernel_names[k], per_pair[t][k] * 1.0e9);
+        }
+        printf(", accumulation %.4f\n", per_point[t] * 1.0e9);
+    }
+
+    printf(" %6s %7s %-12s %12s %12s %14s %8s\n", "Ranks", "Threads", "Kernel", "Compute (s)", "Comm (s)", "Iteration (s)", "Speedup");
+    double predicted[TUNE_MAX_COUNTS][TUNE_MAX_COUNTS][2];
+    double fastest = 0.0;
+    for(int r = 0; r < n_ranks; r++){
+        double rank_points_count = ceil((double)N_POINTS / rank_counts[r]);
+        double comm = tune_collectives_time(alpha[r], beta[r]);
+        for(int t = 0; t < n_threads; t++){
+            // configurations with more threads than the launch's cores are discarded
+            if((long)rank_counts[r] * thread_counts[t] > tune_cores){
+                for(int k = 0; k < n_kernels; k++){
+                    predicted[r][t][k] = 0.0;
+                }
+                continue;
+            }
+            for(int k = 0; k < n_kernels; k++){
+                double compute = (per_pair[t][k] * N_MEANS + per_point[t]) * rank_points_count;
+                predicted[r][t][k] = compute + comm;
+                printf(" %6d %7d %-12s %12.6f %12.6f %14.6f %8.2f\n", rank_counts[r], thread_counts[t], kernel_names[k],
+                    compute, comm, predicted[r][t][k], predicted[0][0][0] / predicted[r][t][k]);
+                if(fastest == 0.0 || predicted[r][t][k] < fastest){
+                    fastest = predicted[r][t][k];
+                }
+            }
+        }
+    }
+
+    // the fewest cores within the tolerance of the fastest prediction
+    int best_r = 0, best_t = 0, best_k = 0;
+    long best_cores = 0;
+    for(int r = 0; r < n_ranks; r++){
+        for(int t = 0; t < n_threads; t++){
+            for(int k = 0; k < n_kernels; k++){
+                long cores = (long)rank_counts[r] * thread_counts[t];
+                if(predicted[r][t][k] > 0.0 && predicted[r][t][k] <= fastest * TUNE_TOLERANCE && (best_cores == 0 || cores < best_cores)){
+                    best_r = r;
+                    best_t = t;
+                    best_k = k;
+                    best_cores = cores;
+                }
+            }
+        }
+    }
+
+    int ranks = rank_counts[best_r], threads = thread_counts[best_t];
+    int generic = (strcmp(kernel_names[best_k], "generic") == 0);
+    char flags[64] = "";
+#if defined(COMPACT)
+    strcat(flags, " COMPACT=ON");
+#endif
+#if defined(ARENA)
+    strcat(flags, " ARENA=ON");
+#endif
+    if(threads > 1){
+        strcat(flags, " HYBRID=ON");
+    }
+    char environment[64] = "";
+    if(threads > 1){
+        snprintf(environment, sizeof(environment), " -x OMP_NUM_THREADS=%d", threads);
+    }
+    printf(" Recommended: %d ranks x %d threads, %s kernel (%.6f s per iteration)\n", ranks, threads, kernel_names[best_k], predicted[best_r][best_t][best_k]);
+    if(generic){
+        printf(" Build: make k_means_runtime%s\n", flags);
+        printf(" Launch: mpirun -np %d%s -x KMEANS_KERNELS=generic ./k_means.runtime.exe %s\n", ranks, environment, (char*)WORKLOAD);
+    }
+    else{
+        printf(" Build: make k_means WORKLOAD=%s%s\n", (char*)WORKLOAD, flags);
+        printf(" Launch: mpirun -np %d%s ./k_means.%s.exe\n", ranks, environment, (char*)WORKLOAD);
+    }
 }
+#endif
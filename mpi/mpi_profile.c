@@ -0,0 +1,405 @@
+// PMPI interposition layer (PROFILE=ON): the collectives of the application go through the
+// wrappers below, which time them and count their bytes per call site (the return address,
+// named after the function that makes the call) before calling the PMPI entry point; the
+// entry times of the first PROFILE_SAMPLES calls of every site, taken from a clock started
+// right after a barrier in MPI_Init, give the arrival skew among the ranks (how long the first
+// rank to arrive waited for the last one)
+// MPI_Finalize combines the sites of every rank and the root prints the summary
+// the wrappers keep no locks: the collectives are made by one thread per rank
+#include <mpi.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__cplusplus)
+#include <cxxabi.h>
+#endif
+
+#define PROFILE_SITES 128
+#define PROFILE_SAMPLES 4096
+
+enum{PROFILE_ALLREDUCE, PROFILE_REDUCE, PROFILE_BCAST, PROFILE_BARRIER, PROFILE_GATHER, PROFILE_GATHERV,
+	PROFILE_ALLGATHER, PROFILE_ALLGATHERV, PROFILE_CALLS};
+const char* profile_call_names[PROFILE_CALLS] = {"MPI_Allreduce", "MPI_Reduce", "MPI_Bcast", "MPI_Barrier",
+	"MPI_Gather", "MPI_Gatherv", "MPI_Allgather", "MPI_Allgatherv"};
+
+typedef struct{
+	int call;
+	void* address;
+	// key of the site on every rank: the call and the return address relative to the executable
+	uint64_t key;
+	long calls;
+	double bytes;
+	double time;
+	int n_samples;
+	double* entries;
+} profile_site;
+
+profile_site profile_sites[PROFILE_SITES];
+int profile_n_sites;
+double profile_epoch;
+
+// the site of the call made from address, created on its first call
+profile_site* profile_find(int call, void* address){
+	for(int s = 0; s < profile_n_sites; s++){
+		if(profile_sites[s].address == address && profile_sites[s].call == call){
+			return &profile_sites[s];
+		}
+	}
+	if(profile_n_sites == PROFILE_SITES){
+		return NULL;
+	}
+	profile_site* site = &profile_sites[profile_n_sites++];
+	memset(site, 0, sizeof(profile_site));
+	site->call = call;
+	site->address = address;
+	Dl_info info;
+	uintptr_t base = (dladdr(address, &info) != 0) ? (uintptr_t)info.dli_fbase : 0;
+	site->key = ((uint64_t)((uintptr_t)address - base) << 4) | (uint64_t)call;
+	site->entries = (double*) malloc(PROFILE_SAMPLES * sizeof(double));
+	return site;
+}
+
+double profile_enter(profile_site* site){
+	double now = PMPI_Wtime();
+	if(site != NULL && site->n_samples < PROFILE_SAMPLES){
+		site->entries[site->n_samples++] = now - profile_epoch;
+	}
+	return now;
+}
+
+void profile_exit(profile_site* site, double start, double bytes){
+	if(site != NULL){
+		site->calls++;
+		site->bytes += bytes;
+		site->time += PMPI_Wtime() - start;
+	}
+}
+
+double profile_bytes(int count, MPI_Datatype datatype){
+	int size = 0;
+	PMPI_Type_size(datatype, &size);
+	return (double)count * size;
+}
+
+// link-time address of the executable's offset (its own for a PIE, after the load base
+// otherwise), the one addr2line takes, and the function around it from the full symbol table:
+// dladdr only knows the exported symbols, not the static functions or the compiler's clones
+// (phase_timers_reduce [clone .part.0]); returns 0 without a symbol (stripped executable)
+int profile_symbol(const char* path, uintptr_t base, uintptr_t offset, uintptr_t* address, char* symbol, size_t size, uintptr_t* start){
+	*address = offset;
+	FILE* file = fopen(path, "rb");
+	if(file == NULL){
+		return 0;
+	}
+	int found = 0;
+	Elf64_Ehdr header;
+	if(fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.e_ident, ELFMAG, SELFMAG) == 0 &&
+		header.e_ident[EI_CLASS] == ELFCLASS64){
+		*address = (header.e_type == ET_EXEC) ? base + offset : offset;
+		Elf64_Shdr* sections = (Elf64_Shdr*) malloc(header.e_shnum * sizeof(Elf64_Shdr));
+		if(sections != NULL && fseek(file, (long)header.e_shoff, SEEK_SET) == 0 &&
+			fread(sections, sizeof(Elf64_Shdr), header.e_shnum, file) == header.e_shnum){
+			for(int s = 0; s < header.e_shnum && !found; s++){
+				if(sections[s].sh_type != SHT_SYMTAB || sections[s].sh_link >= header.e_shnum){
+					continue;
+				}
+				const Elf64_Shdr* strings = &sections[sections[s].sh_link];
+				Elf64_Sym* symbols = (Elf64_Sym*) malloc(sections[s].sh_size);
+				char* names = (char*) malloc(strings->sh_size + 1);
+				if(symbols != NULL && names != NULL &&
+					fseek(file, (long)sections[s].sh_offset, SEEK_SET) == 0 && fread(symbols, sections[s].sh_size, 1, file) == 1 &&
+					fseek(file, (long)strings->sh_offset, SEEK_SET) == 0 && fread(names, strings->sh_size, 1, file) == 1){
+					names[strings->sh_size] = '\0';
+					size_t n = sections[s].sh_size / sizeof(Elf64_Sym);
+					for(size_t i = 0; i < n; i++){
+						if(ELF64_ST_TYPE(symbols[i].st_info) == STT_FUNC && symbols[i].st_name < strings->sh_size &&
+							*address >= symbols[i].st_value && *address < symbols[i].st_value + symbols[i].st_size){
+							snprintf(symbol, size, "%s", names + symbols[i].st_name);
+							*start = symbols[i].st_value;
+							found = 1;
+							break;
+						}
+					}
+				}
+				free(symbols);
+				free(names);
+			}
+		}
+		free(sections);
+	}
+	fclose(file);
+	return found;
+}
+
+// function of the executable containing the call site of the key (on the root, whose
+// executable is the same as every other rank's), or the executable and the address to give
+// addr2line when it has no symbols
+void profile_site_name(uint64_t key, char* name, size_t size){
+	uintptr_t offset = (uintptr_t)(key >> 4);
+	Dl_info self;
+	uintptr_t base = (dladdr((void*)&profile_site_name, &self) != 0) ? (uintptr_t)self.dli_fbase : 0;
+	char path[512];
+	ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+	path[(length > 0) ? length : 0] = '\0';
+	const char* executable = (strrchr(path, '/') != NULL) ? strrchr(path, '/') + 1 : path;
+
+	char symbol[256];
+	uintptr_t address, start;
+	if(!profile_symbol(path, base, offset, &address, symbol, sizeof(symbol), &start)){
+		snprintf(name, size, "%s:0x%lx", executable, (unsigned long)address);
+		return;
+	}
+	const char* shown = symbol;
+#if defined(__cplusplus)
+	int status;
+	char* demangled = abi::__cxa_demangle(symbol, NULL, NULL, &status);
+	if(status == 0 && demangled != NULL){
+		// the parameters (and the clone suffix after them) are left out
+		char* parameters = strchr(demangled, '(');
+		if(parameters != NULL){
+			*parameters = '\0';
+		}
+		shown = demangled;
+	}
+#endif
+	snprintf(name, size, "%s+0x%lx", shown, (unsigned long)(address - start));
+#if defined(__cplusplus)
+	free(demangled);
+#endif
+}
+
+void profile_start(){
+	PMPI_Barrier(MPI_COMM_WORLD);
+	profile_epoch = PMPI_Wtime();
+	profile_n_sites = 0;
+}
+
+int profile_compare_keys(const void* a, const void* b){
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+// collective: every rank's sites are matched by key, the root prints per site the calls, the
+// bytes per rank, the time inside the call (avg and max over the ranks) and the arrival skew
+void profile_report(){
+	int rank, nprocs;
+	PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	PMPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+	double elapsed = PMPI_Wtime() - profile_epoch, elapsed_max;
+
+	// union of the sites, in the same order on every rank
+	uint64_t local_keys[PROFILE_SITES];
+	memset(local_keys, 0, sizeof(local_keys));
+	for(int s = 0; s < profile_n_sites; s++){
+		local_keys[s] = profile_sites[s].key;
+	}
+	uint64_t* all_keys = (uint64_t*) malloc((size_t)nprocs * PROFILE_SITES * sizeof(uint64_t));
+	PMPI_Gather(local_keys, PROFILE_SITES, MPI_UINT64_T, all_keys, PROFILE_SITES, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+	uint64_t keys[PROFILE_SITES];
+	int n_keys = 0;
+	if(rank == 0){
+		qsort(all_keys, (size_t)nprocs * PROFILE_SITES, sizeof(uint64_t), profile_compare_keys);
+		for(int k = 0; k < nprocs * PROFILE_SITES && n_keys < PROFILE_SITES; k++){
+			if(all_keys[k] != 0 && (n_keys == 0 || keys[n_keys - 1] != all_keys[k])){
+				keys[n_keys++] = all_keys[k];
+			}
+		}
+	}
+	free(all_keys);
+	PMPI_Bcast(&n_keys, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	PMPI_Bcast(keys, n_keys, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+	// per site: calls, bytes and time (summed), calls, time and samples (maximum), time (minimum)
+	double* local = (double*) calloc(6 * (size_t)(n_keys + 1), sizeof(double));
+	double* sums = (double*) calloc(3 * (size_t)(n_keys + 1), sizeof(double));
+	double* maxima = (double*) calloc(3 * (size_t)(n_keys + 1), sizeof(double));
+	double* minima = (double*) calloc((size_t)(n_keys + 1), sizeof(double));
+	profile_site** mine = (profile_site**) calloc((size_t)(n_keys + 1), sizeof(profile_site*));
+	for(int k = 0; k < n_keys; k++){
+		for(int s = 0; s < profile_n_sites; s++){
+			if(profile_sites[s].key == keys[k]){
+				mine[k] = &profile_sites[s];
+			}
+		}
+		local[3 * k + 0] = (mine[k] != NULL) ? mine[k]->calls : 0.0;
+		local[3 * k + 1] = (mine[k] != NULL) ? mine[k]->bytes : 0.0;
+		local[3 * k + 2] = (mine[k] != NULL) ? mine[k]->time : 0.0;
+		local[3 * n_keys + 3 * k + 0] = local[3 * k + 0];
+		local[3 * n_keys + 3 * k + 1] = local[3 * k + 2];
+		local[3 * n_keys + 3 * k + 2] = (mine[k] != NULL) ? mine[k]->n_samples : 0.0;
+	}
+	PMPI_Reduce(local, sums, 3 * n_keys, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+	PMPI_Allreduce(&local[3 * n_keys], maxima, 3 * n_keys, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	double* times = (double*) malloc((size_t)(n_keys + 1) * sizeof(double));
+	for(int k = 0; k < n_keys; k++){
+		// ranks that never made the call do not count for the minimum
+		times[k] = (mine[k] != NULL) ? mine[k]->time : INFINITY;
+	}
+	PMPI_Reduce(times, minima, n_keys, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+	PMPI_Reduce(&elapsed, &elapsed_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+	// first and last arrival of every sampled call
+	long n_samples = 0;
+	for(int k = 0; k < n_keys; k++){
+		n_samples += (long)maxima[3 * k + 2];
+	}
+	double* first = (double*) malloc((size_t)(n_samples + 1) * sizeof(double));
+	double* last = (double*) malloc((size_t)(n_samples + 1) * sizeof(double));
+	double* first_all = (double*) malloc((size_t)(n_samples + 1) * sizeof(double));
+	double* last_all = (double*) malloc((size_t)(n_samples + 1) * sizeof(double));
+	for(int k = 0, offset = 0; k < n_keys; offset += (int)maxima[3 * k + 2], k++){
+		for(int c = 0; c < (int)maxima[3 * k + 2]; c++){
+			int sampled = (mine[k] != NULL && c < mine[k]->n_samples);
+			first[offset + c] = sampled ? mine[k]->entries[c] : INFINITY;
+			last[offset + c] = sampled ? mine[k]->entries[c] : -INFINITY;
+		}
+	}
+	PMPI_Reduce(first, first_all, (int)n_samples, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+	PMPI_Reduce(last, last_all, (int)n_samples, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+	if(rank == 0){
+		double total_sum = 0.0;
+		printf("\n MPI profile: %d ranks, %.6f s\n", nprocs, elapsed_max);
+		printf(" %-14s %-40s %10s %14s %12s %12s %12s %12s %12s\n", "Call", "Site", "Calls", "Bytes/rank",
+			"Min (s)", "Avg (s)", "Max (s)", "Skew avg (s)", "Skew max (s)");
+		for(int k = 0, offset = 0; k < n_keys; offset += (int)maxima[3 * k + 2], k++){
+			double skew_sum = 0.0, skew_max = 0.0;
+			int n_skews = 0;
+			for(int c = 0; c < (int)maxima[3 * k + 2]; c++){
+				if(isfinite(first_all[offset + c]) && isfinite(last_all[offset + c])){
+					double skew = last_all[offset + c] - first_all[offset + c];
+					skew_sum += skew;
+					skew_max = (skew > skew_max) ? skew : skew_max;
+					n_skews++;
+				}
+			}
+			char name[256];
+			profile_site_name(keys[k], name, sizeof(name));
+			total_sum += sums[3 * k + 2];
+			printf(" %-14s %-40s %10ld %14.0f %12.6f %12.6f %12.6f %12.6f %12.6f\n",
+				profile_call_names[keys[k] & 15], name, (long)maxima[3 * k + 0], sums[3 * k + 1] / nprocs,
+				minima[k], sums[3 * k + 2] / nprocs, maxima[3 * k + 1],
+				(n_skews > 0) ? skew_sum / n_skews : 0.0, skew_max);
+		}
+		printf(" Collectives: %.6f s per rank on average, %.2f%% of the run\n", total_sum / nprocs,
+			(elapsed_max > 0.0) ? total_sum / nprocs * 100.0 / elapsed_max : 0.0);
+		fflush(stdout);
+	}
+
+	free(local);
+	free(sums);
+	free(maxima);
+	free(minima);
+	free(mine);
+	free(times);
+	free(first);
+	free(last);
+	free(first_all);
+	free(last_all);
+	for(int s = 0; s < profile_n_sites; s++){
+		free(profile_sites[s].entries);
+	}
+	profile_n_sites = 0;
+}
+
+// never inlined (LTO), so the return address is the application's call site
+#define PROFILE_WRAPPER __attribute__((noinline))
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+PROFILE_WRAPPER int MPI_Init(int* argc, char*** argv){
+	int result = PMPI_Init(argc, argv);
+	profile_start();
+	return result;
+}
+
+PROFILE_WRAPPER int MPI_Init_thread(int* argc, char*** argv, int required, int* provided){
+	int result = PMPI_Init_thread(argc, argv, required, provided);
+	profile_start();
+	return result;
+}
+
+PROFILE_WRAPPER int MPI_Finalize(void){
+	profile_report();
+	return PMPI_Finalize();
+}
+
+PROFILE_WRAPPER int MPI_Allreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm){
+	profile_site* site = profile_find(PROFILE_ALLREDUCE, __builtin_return_address(0));
+	double start = profile_enter(site);
+	int result = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+	profile_exit(site, start, profile_bytes(count, datatype));
+	return result;
+}
+
+PROFILE_WRAPPER int MPI_Reduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm){
+	profile_site* site = profile_find(PROFILE_REDUCE, __builtin_return_address(0));
+	double start = profile_enter(site);
+	int result = PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm);
+	profile_exit(site, start, profile_bytes(count, datatype));
+	return result;
+}
+
+PROFILE_WRAPPER int MPI_Bcast(void* buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm){
+	profile_site* site = profile_find(PROFILE_BCAST, __builtin_return_address(0));
+	double start = profile_enter(site);
+	int result = PMPI_Bcast(buffer, count, datatype, root, comm);
+	profile_exit(site, start, profile_bytes(count, datatype));
+	return result;
+}
+
+PROFILE_WRAPPER int MPI_Barrier(MPI_Comm comm){
+	profile_site* site = profile_find(PROFILE_BARRIER, __builtin_return_address(0));
+	double start = profile_enter(site);
+	int result = PMPI_Barrier(comm);
+	profile_exit(site, start, 0.0);
+	return result;
+}
+
+// the bytes of the gathers are the ones each rank sends (none for the root's MPI_IN_PLACE)
+PROFILE_WRAPPER int MPI_Gather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
+	MPI_Datatype recvtype, int root, MPI_Comm comm){
+	profile_site* site = profile_find(PROFILE_GATHER, __builtin_return_address(0));
+	double start = profile_enter(site);
+	int result = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+	profile_exit(site, start, (sendbuf == MPI_IN_PLACE) ? 0.0 : profile_bytes(sendcount, sendtype));
+	return result;
+}
+
+PROFILE_WRAPPER int MPI_Gatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[],
+	const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm){
+	profile_site* site = profile_find(PROFILE_GATHERV, __builtin_return_address(0));
+	double start = profile_enter(site);
+	int result = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+	profile_exit(site, start, (sendbuf == MPI_IN_PLACE) ? 0.0 : profile_bytes(sendcount, sendtype));
+	return result;
+}
+
+PROFILE_WRAPPER int MPI_Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
+	MPI_Datatype recvtype, MPI_Comm comm){
+	profile_site* site = profile_find(PROFILE_ALLGATHER, __builtin_return_address(0));
+	double start = profile_enter(site);
+	int result = PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+	profile_exit(site, start, (sendbuf == MPI_IN_PLACE) ? 0.0 : profile_bytes(sendcount, sendtype));
+	return result;
+}
+
+PROFILE_WRAPPER int MPI_Allgatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[],
+	const int displs[], MPI_Datatype recvtype, MPI_Comm comm){
+	profile_site* site = profile_find(PROFILE_ALLGATHERV, __builtin_return_address(0));
+	double start = profile_enter(site);
+	int result = PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+	profile_exit(site, start, (sendbuf == MPI_IN_PLACE) ? 0.0 : profile_bytes(sendcount, sendtype));
+	return result;
+}
+
+#if defined(__cplusplus)
+}
+#endif
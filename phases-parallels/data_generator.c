@@ -1,148 +1,562 @@
-
 #include "include/k-means/k_means.h"
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+// seed shared by every workload (each class draws from its own streams)
+#define GENERATOR_SEED 0x6b2d6d65616e73ULL
+
+// streams of the random generator
+#define STREAM_POINTS_X 0
+#define STREAM_POINTS_Y 1
+#define STREAM_MEANS_X 2
+#define STREAM_MEANS_Y 3
+
+// uniform grid over the means, used by the reference solver to find the nearest mean
+typedef struct{
+    int size;
+    double cell;
+    int* start;
+    int* index;
+} means_grid;
+
+// counter-based random generator (splitmix64 finalizer)
+// the value drawn for (workload, stream, index) does not depend on the number of threads
+// or on the order of the draws, so the data set is the same for any OMP_NUM_THREADS
+uint64_t data_generator_random(const workload_class* workload, uint64_t stream, uint64_t index){
+    uint64_t z = GENERATOR_SEED ^ ((uint64_t)workload->name[0] << 56) ^ (stream << 48);
+    z += (index + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void data_generator_initialize(const workload_class* workload){
+    int interval = workload->interval;
+
+    #pragma omp parallel for schedule(static)
+    for(int i = 0; i < workload->n_points; i++){
+        points[i].x = data_generator_random(workload, STREAM_POINTS_X, i) % interval;
+        points[i].y = data_generator_random(workload, STREAM_POINTS_Y, i) % interval;
+        points[i].cluster = 0;
+    }
+    for(int i = 0; i < workload->n_means; i++){
+        means[i].x = data_generator_random(workload, STREAM_MEANS_X, i) % interval;
+        means[i].y = data_generator_random(workload, STREAM_MEANS_Y, i) % interval;
+        means[i].count = 0;
+    }
+}
+
+int data_generator_grid_cell(const means_grid* grid, double value){
+    int cell = (int)(value / grid->cell);
+    if(cell < 0){cell = 0;}
+    if(cell >= grid->size){cell = grid->size - 1;}
+    return cell;
+}
+
+void data_generator_build_grid(means_grid* grid, int n_means){
+    int cells = grid->size * grid->size;
+    int* cell_of = (int*) malloc(n_means * sizeof(int));
+
+    memset(grid->start, 0, (cells + 1) * sizeof(int));
+    for(int j = 0; j < n_means; j++){
+        cell_of[j] = data_generator_grid_cell(grid, means[j].y) * grid->size + data_generator_grid_cell(grid, means[j].x);
+        grid->start[cell_of[j] + 1]++;
+    }
+    for(int c = 0; c < cells; c++){
+        grid->start[c + 1] += grid->start[c];
+    }
+
+    int* fill = (int*) malloc(cells * sizeof(int));
+    memcpy(fill, grid->start, cells * sizeof(int));
+    for(int j = 0; j < n_means; j++){
+        grid->index[fill[cell_of[j]]++] = j;
+    }
+
+    free(fill);
+    free(cell_of);
+}
+
+// exact nearest mean, same result as the brute-force scan (ties go to the lowest index)
+// the cells are visited in rings around the point, and the search stops once the distance
+// to the outside of the visited block is larger than the best distance found so far
+int data_generator_nearest_mean(const means_grid* grid, double px, double py){
+    int cx = data_generator_grid_cell(grid, px);
+    int cy = data_generator_grid_cell(grid, py);
+    // keeps rounding of the cell boundaries from cutting the search short
+    double margin = grid->cell * 1e-6;
+
+    double min_dist = INFINITY;
+    int min_idx = -1;
 
-void data_generator_find_clusters(){
-    for(int i = 0; i < N_POINTS; i++){
-        double min_dist = (points[i].x - means[0].x) * (points[i].x - means[0].x)
-                        + (points[i].y - means[0].y) * (points[i].y - means[0].y);
-        int min_idx = 0;
-
-        for(int j = 1; j < N_MEANS; j++){
-            double cur_dist = (points[i].x - means[j].x) * (points[i].x - means[j].x)
-                            + (points[i].y - means[j].y) * (points[i].y - means[j].y);
-            if(cur_dist < min_dist){
-                min_dist = cur_dist;
-                min_idx = j;
+    for(int r = 0; ; r++){
+        int x0 = cx - r, x1 = cx + r, y0 = cy - r, y1 = cy + r;
+
+        for(int gy = (y0 < 0 ? 0 : y0); gy <= (y1 < grid->size ? y1 : grid->size - 1); gy++){
+            int ring_row = (gy == y0 || gy == y1);
+            for(int gx = (x0 < 0 ? 0 : x0); gx <= (x1 < grid->size ? x1 : grid->size - 1); gx++){
+                // only the cells on the ring, the inner ones were visited before
+                if(!ring_row && gx != x0 && gx != x1){
+                    gx = x1 - 1;
+                    continue;
+                }
+                int c = gy * grid->size + gx;
+                for(int k = grid->start[c]; k < grid->start[c + 1]; k++){
+                    int j = grid->index[k];
+                    double cur_dist = (px - means[j].x) * (px - means[j].x)
+                                    + (py - means[j].y) * (py - means[j].y);
+                    if(cur_dist < min_dist || (cur_dist == min_dist && j < min_idx)){
+                        min_dist = cur_dist;
+                        min_idx = j;
+                    }
+                }
             }
         }
 
+        if(x0 <= 0 && y0 <= 0 && x1 >= grid->size - 1 && y1 >= grid->size - 1){
+            break;
+        }
+        double bound = INFINITY;
+        if(x0 > 0){bound = fmin(bound, px - x0 * grid->cell);}
+        if(x1 < grid->size - 1){bound = fmin(bound, (x1 + 1) * grid->cell - px);}
+        if(y0 > 0){bound = fmin(bound, py - y0 * grid->cell);}
+        if(y1 < grid->size - 1){bound = fmin(bound, (y1 + 1) * grid->cell - py);}
+        bound -= margin;
+        if(min_idx >= 0 && bound > 0.0 && bound * bound > min_dist){
+            break;
+        }
+    }
+
+    return min_idx;
+}
+
+void data_generator_find_clusters(const workload_class* workload, const means_grid* grid){
+    int changed = 0;
+
+    #pragma omp parallel for schedule(dynamic, 4096) reduction(|:changed)
+    for(int i = 0; i < workload->n_points; i++){
+        int min_idx = data_generator_nearest_mean(grid, points[i].x, points[i].y);
+
         if(points[i].cluster != min_idx){
             points[i].cluster = min_idx;
-            modified = 1;
+            changed = 1;
         }
     }
+
+    modified = changed;
 }
 
-void data_generator_calculate_means(){
-    for(int i = 0; i < N_MEANS; i++){
-        means[i].count = 0;
+// the coordinates are integers, so the sums are accumulated exactly in 64-bit integers
+// and the result does not depend on how the points are split among the threads
+void data_generator_calculate_means(const workload_class* workload){
+    int n_means = workload->n_means;
+    long long* sum_x = (long long*) calloc(n_means, sizeof(long long));
+    long long* sum_y = (long long*) calloc(n_means, sizeof(long long));
+    int* count = (int*) calloc(n_means, sizeof(int));
+
+    #pragma omp parallel for schedule(static) reduction(+:sum_x[:n_means], sum_y[:n_means], count[:n_means])
+    for(int i = 0; i < workload->n_points; i++){
+        int cluster = points[i].cluster;
+        count[cluster]++;
+        sum_x[cluster] += (long long)points[i].x;
+        sum_y[cluster] += (long long)points[i].y;
+    }
+
+    // like the k-means kernels, an empty cluster has its mean reset to the origin
+    for(int i = 0; i < n_means; i++){
+        means[i].count = count[i];
         means[i].x = 0.0;
         means[i].y = 0.0;
+        if(count[i] > 0){
+            means[i].x = (double)sum_x[i] / count[i];
+            means[i].y = (double)sum_y[i] / count[i];
+        }
     }
 
-    for(int i = 0; i < N_POINTS; i++){
-        int cluster = points[i].cluster;
-        means[cluster].count++;
-        means[cluster].x += points[i].x;
-        means[cluster].y += points[i].y;
+    free(sum_x);
+    free(sum_y);
+    free(count);
+}
+
+void data_generator_k_means(const workload_class* workload){
+    means_grid grid;
+    grid.size = (int)ceil(sqrt((double)workload->n_means));
+    grid.cell = (double)workload->interval / grid.size;
+    grid.start = (int*) malloc((grid.size * grid.size + 1) * sizeof(int));
+    grid.index = (int*) malloc(workload->n_means * sizeof(int));
+
+    modified = 1;
+    iteration_control = 0;
+    while(modified){
+        modified = 0;
+        data_generator_build_grid(&grid, workload->n_means);
+        data_generator_find_clusters(workload, &grid);
+        data_generator_calculate_means(workload);
+        iteration_control++;
     }
 
-    for(int i = 0; i < N_MEANS; i++){
-        if(means[i].count > 0){
-            means[i].x /= means[i].count;
-            means[i].y /= means[i].count;
+    free(grid.start);
+    free(grid.index);
+}
+
+// data set formats
+#define FORMAT_TEXT 1
+#define FORMAT_BINARY 2
+
+// lines formatted by each thread at a time
+#define WRITER_CHUNK 65536
+// upper bound of one formatted line ("%la %la %d\n" with the longest values)
+#define WRITER_LINE_BYTES 64
+
+typedef int (*writer_line_function)(char* out, const void* data, int i);
+
+// same output as printf("%d")
+int writer_format_int(char* out, int value){
+    char digits[12];
+    int n = 0;
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    do{
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while(magnitude != 0);
+
+    int length = 0;
+    if(value < 0){out[length++] = '-';}
+    while(n > 0){out[length++] = digits[--n];}
+    return length;
+}
+
+// same output as printf("%la") for finite values
+int writer_format_hex_double(char* out, double value){
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(double));
+    int biased_exponent = (int)((bits >> 52) & 0x7ff);
+    uint64_t mantissa = bits & ((1ULL << 52) - 1);
+
+    if(biased_exponent == 0x7ff){
+        return sprintf(out, "%la", value);
+    }
+
+    char* p = out;
+    if(bits >> 63){*p++ = '-';}
+    *p++ = '0';
+    *p++ = 'x';
+
+    int exponent;
+    if(biased_exponent == 0){
+        *p++ = '0';
+        exponent = (mantissa == 0) ? 0 : -1022;
+    }
+    else{
+        *p++ = '1';
+        exponent = biased_exponent - 1023;
+    }
+
+    if(mantissa != 0){
+        int digits = 13;
+        while((mantissa & 0xf) == 0){
+            mantissa >>= 4;
+            digits--;
+        }
+        *p++ = '.';
+        for(int d = digits - 1; d >= 0; d--){
+            p[d] = "0123456789abcdef"[mantissa & 0xf];
+            mantissa >>= 4;
         }
+        p += digits;
     }
+
+    *p++ = 'p';
+    *p++ = (exponent < 0) ? '-' : '+';
+    p += writer_format_int(p, exponent < 0 ? -exponent : exponent);
+    return (int)(p - out);
 }
 
-int main(){
-    //////////////////////////////////////////////////
-    // allocate points, means, and verification values
-    points = (point*) malloc(N_POINTS * sizeof(point));
-    means = (mean*) malloc(N_MEANS * sizeof(mean));
+int writer_point_line(char* out, const void* data, int i){
+    const point* p = (const point*) data;
+    char* o = out;
+    o += writer_format_hex_double(o, (double)p[i].x);
+    *o++ = ' ';
+    o += writer_format_hex_double(o, (double)p[i].y);
+    // initial cluster
+    *o++ = ' ';
+    *o++ = '0';
+    *o++ = '\n';
+    return (int)(o - out);
+}
 
-    //////////////////////////////
-    // initialize points and means
-    for (int i = 0; i < N_POINTS; i++) {
-        points[i].x = rand() % INTERVAL;
-        points[i].y = rand() % INTERVAL;
-        points[i].cluster = 0;
+int writer_cluster_line(char* out, const void* data, int i){
+    const point* p = (const point*) data;
+    int length = writer_format_int(out, p[i].cluster);
+    out[length] = '\n';
+    return length + 1;
+}
+
+int writer_mean_line(char* out, const void* data, int i){
+    const mean* m = (const mean*) data;
+    char* o = out;
+    o += writer_format_hex_double(o, m[i].x);
+    *o++ = ' ';
+    o += writer_format_hex_double(o, m[i].y);
+    *o++ = ' ';
+    o += writer_format_int(o, m[i].count);
+    *o++ = '\n';
+    return (int)(o - out);
+}
+
+// formats the n lines of a section in parallel chunks, then closes the gaps between the
+// chunks so the section can go to the file with a single write
+size_t writer_format_lines(char* buffer, int n, writer_line_function format_line, const void* data){
+    int chunks = (n + WRITER_CHUNK - 1) / WRITER_CHUNK;
+    size_t* lengths = (size_t*) malloc(chunks * sizeof(size_t));
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(int c = 0; c < chunks; c++){
+        char* out = buffer + (size_t)c * WRITER_CHUNK * WRITER_LINE_BYTES;
+        char* p = out;
+        int end = (c + 1) * WRITER_CHUNK < n ? (c + 1) * WRITER_CHUNK : n;
+        for(int i = c * WRITER_CHUNK; i < end; i++){
+            p += format_line(p, data, i);
+        }
+        lengths[c] = p - out;
     }
-    for (int i = 0; i < N_MEANS; i++) {
-        means[i].x = rand() % INTERVAL;
-        means[i].y = rand() % INTERVAL;
-        means[i].count = 0;
+
+    size_t size = 0;
+    for(int c = 0; c < chunks; c++){
+        memmove(buffer + size, buffer + (size_t)c * WRITER_CHUNK * WRITER_LINE_BYTES, lengths[c]);
+        size += lengths[c];
+    }
+
+    free(lengths);
+    return size;
+}
+
+// "<n>\n\n", the n lines, then five blank lines (same layout as the original fprintf writer)
+void writer_text_section(FILE* file, char* buffer, int n, writer_line_function format_line, const void* data){
+    size_t size = sprintf(buffer, "%d\n\n", n);
+    size += writer_format_lines(buffer + size, n, format_line, data);
+    memcpy(buffer + size, "\n\n\n\n\n", 5);
+    size += 5;
+    if(fwrite(buffer, 1, size, file) != size){
+        printf("Error when trying to write a file!\n");
+        exit(-1);
+    }
+}
+
+void writer_binary_section(FILE* file, const void* data, size_t size, size_t n){
+    if(fwrite(data, size, n, file) != n){
+        printf("Error when trying to write a file!\n");
+        exit(-1);
     }
+}
 
-    ///////////////////////////
-    // write data set in a file
-    FILE* file;
+void write_text_dataset(const workload_class* workload, mean* means_initial){
     char file_name[64];
-	sprintf(file_name, "data.%s.txt", (char*)WORKLOAD);
-    file = fopen(file_name, "wt");
+    sprintf(file_name, "data.%s.txt", workload->name);
+    FILE* file = fopen(file_name, "wt");
     if(file == NULL){
         printf("Error when trying to open a file!\n");
         exit(-1);
     }
-    else{
-        // write N_POINTS
-        fprintf(file, "%d\n", N_POINTS);
-        // blank line
-        fprintf(file, "\n");	
-        // write points
-        for(int i = 0; i < N_POINTS; i++){
-		    fprintf(file, "%la %la %d\n", points[i].x, points[i].y, points[i].cluster);
-	    }
-        // blank lines
-        fprintf(file, "\n\n\n\n\n");
-        // write N_MEANS
-        fprintf(file, "%d\n", N_MEANS);
-        // blank line
-        fprintf(file, "\n");
-        // write means
-        for(int i = 0; i < N_MEANS; i++){
-		    fprintf(file, "%la %la %d\n", means[i].x, means[i].y, means[i].count);
-	    }
-        // blank lines
-        fprintf(file, "\n\n\n\n\n");
-    }
+
+    int n_points = workload->n_points;
+    int n_means = workload->n_means;
+    char* buffer = (char*) malloc((size_t)n_points * WRITER_LINE_BYTES + 64);
+
+    // input data: points and initial means
+    writer_text_section(file, buffer, n_points, writer_point_line, points);
+    writer_text_section(file, buffer, n_means, writer_mean_line, means_initial);
+    // results: clusters, means, and iterations to converge
+    writer_text_section(file, buffer, n_points, writer_cluster_line, points);
+    writer_text_section(file, buffer, n_means, writer_mean_line, means);
+    fprintf(file, "%d\n", iteration_control);
+
+    free(buffer);
     fclose(file);
+}
 
-    //////////////
-    // run k-means
-    modified = 1;
-    iteration_control = 0;
-    while(modified){
-        modified = 0;
-        data_generator_find_clusters();
-        data_generator_calculate_means();
-        iteration_control++;
+void write_binary_dataset(const workload_class* workload, mean* means_initial){
+    char file_name[64];
+    sprintf(file_name, "data.%s.bin", workload->name);
+    FILE* file = fopen(file_name, "wb");
+    if(file == NULL){
+        printf("Error when trying to open a file!\n");
+        exit(-1);
     }
 
-    ///////////////////////////////////
-    // write data set results in a file
-    file = fopen(file_name, "at");
+    int n_points = workload->n_points;
+    int n_means = workload->n_means;
+
+    dataset_header header;
+    memcpy(header.magic, DATASET_MAGIC, 4);
+    header.n_points = n_points;
+    header.n_means = n_means;
+    header.coord_bytes = sizeof(coord_t);
+    header.iterations = iteration_control;
+    writer_binary_section(file, &header, sizeof(dataset_header), 1);
+
+    // points, stored as separate x and y arrays
+    coord_t* x = (coord_t*) malloc(n_points * sizeof(coord_t));
+    coord_t* y = (coord_t*) malloc(n_points * sizeof(coord_t));
+    int* clusters = (int*) malloc(n_points * sizeof(int));
+    #pragma omp parallel for schedule(static)
+    for(int i = 0; i < n_points; i++){
+        x[i] = points[i].x;
+        y[i] = points[i].y;
+        clusters[i] = points[i].cluster;
+    }
+    writer_binary_section(file, x, sizeof(coord_t), n_points);
+    writer_binary_section(file, y, sizeof(coord_t), n_points);
+    free(x);
+    free(y);
+
+    // initial means
+    double* values = (double*) malloc(n_means * sizeof(double));
+    for(int i = 0; i < n_means; i++){values[i] = means_initial[i].x;}
+    writer_binary_section(file, values, sizeof(double), n_means);
+    for(int i = 0; i < n_means; i++){values[i] = means_initial[i].y;}
+    writer_binary_section(file, values, sizeof(double), n_means);
+
+    // results
+    writer_binary_section(file, clusters, sizeof(int), n_points);
+    for(int i = 0; i < n_means; i++){values[i] = means[i].x;}
+    writer_binary_section(file, values, sizeof(double), n_means);
+    for(int i = 0; i < n_means; i++){values[i] = means[i].y;}
+    writer_binary_section(file, values, sizeof(double), n_means);
+    for(int i = 0; i < n_means; i++){clusters[i] = means[i].count;}
+    writer_binary_section(file, clusters, sizeof(int), n_means);
+    free(values);
+    free(clusters);
+
+    fclose(file);
+}
+
+// digests used by the hash verification of the k-means programs
+void write_digest(const workload_class* workload){
+    char file_name[64];
+    sprintf(file_name, "data.%s.digest", workload->name);
+    FILE* file = fopen(file_name, "wb");
     if(file == NULL){
         printf("Error when trying to open a file!\n");
         exit(-1);
     }
-    else{
-        // write N_POINTS
-        fprintf(file, "%d\n", N_POINTS);
-        // blank line
-        fprintf(file, "\n");	
-        // write points
-        for(int i = 0; i < N_POINTS; i++){
-		    fprintf(file, "%d\n", points[i].cluster);
-	    }
-        // blank lines
-        fprintf(file, "\n\n\n\n\n");
-        // write N_MEANS
-        fprintf(file, "%d\n", N_MEANS);
-        // blank line
-        fprintf(file, "\n");
-        // write means' results
-        for(int i = 0; i < N_MEANS; i++){
-		    fprintf(file, "%la %la %d\n", means[i].x, means[i].y, means[i].count);
-	    }
-        // blank lines
-        fprintf(file, "\n\n\n\n\n");
-        // iterations to converge
-        fprintf(file, "%d\n", iteration_control);
+
+    int n_points = workload->n_points;
+    int n_means = workload->n_means;
+
+    digest_header header;
+    memcpy(header.magic, DIGEST_MAGIC, 4);
+    header.n_points = n_points;
+    header.n_means = n_means;
+    header.block_points = DIGEST_BLOCK_POINTS;
+    header.block_means = DIGEST_BLOCK_MEANS;
+    writer_binary_section(file, &header, sizeof(digest_header), 1);
+
+    int point_blocks = (n_points + DIGEST_BLOCK_POINTS - 1) / DIGEST_BLOCK_POINTS;
+    int mean_blocks = (n_means + DIGEST_BLOCK_MEANS - 1) / DIGEST_BLOCK_MEANS;
+    uint64_t* hashes = (uint64_t*) malloc((point_blocks + mean_blocks) * sizeof(uint64_t));
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(int b = 0; b < point_blocks; b++){
+        int end = (b + 1) * DIGEST_BLOCK_POINTS < n_points ? (b + 1) * DIGEST_BLOCK_POINTS : n_points;
+        hashes[b] = digest_clusters(b * DIGEST_BLOCK_POINTS, end);
+    }
+    for(int b = 0; b < mean_blocks; b++){
+        int end = (b + 1) * DIGEST_BLOCK_MEANS < n_means ? (b + 1) * DIGEST_BLOCK_MEANS : n_means;
+        hashes[point_blocks + b] = digest_counts(b * DIGEST_BLOCK_MEANS, end);
     }
+    writer_binary_section(file, hashes, sizeof(uint64_t), point_blocks + mean_blocks);
+
+    free(hashes);
     fclose(file);
+}
+
+void generate_workload(const workload_class* workload, int formats){
+    int n_points = workload->n_points;
+    int n_means = workload->n_means;
+
+    if((double)(workload->interval - 1) != (double)(coord_t)(workload->interval - 1)){
+        printf("Error: workload %s does not fit the coordinate type!\n", workload->name);
+        exit(-1);
+    }
+
+    //////////////////////////////////////////////////
+    // allocate points, means, and verification values
+    points = (point*) malloc(n_points * sizeof(point));
+    means = (mean*) malloc(n_means * sizeof(mean));
+
+    //////////////////////////////
+    // initialize points and means
+    data_generator_initialize(workload);
+
+    // the data set is written after k-means, so keep the initial means
+    mean* means_initial = (mean*) malloc(n_means * sizeof(mean));
+    memcpy(means_initial, means, n_means * sizeof(mean));
 
+    //////////////
+    // run k-means
+    data_generator_k_means(workload);
+
+    ///////////////////////////////////////
+    // write data set and results in files
+    if(formats & FORMAT_TEXT){
+        write_text_dataset(workload, means_initial);
+    }
+    if(formats & FORMAT_BINARY){
+        write_binary_dataset(workload, means_initial);
+    }
+    write_digest(workload);
+
+    free(means_initial);
     free(points);
     free(means);
+}
+
+// usage: ./data_generator.<WORKLOAD>.exe [--format=text|binary|both] [workload ...]
+// without workloads the one selected at compile time is generated; the default format is
+// text, plus the binary data set when built with COMPACT=ON
+int main(int argc, char* argv[]){
+    int threads = 1;
+#if defined(_OPENMP)
+    threads = omp_get_max_threads();
+#endif
+
+    int formats = FORMAT_TEXT;
+#if defined(COMPACT)
+    formats |= FORMAT_BINARY;
+#endif
+
+    const workload_class* workloads[N_WORKLOAD_CLASSES];
+    int n_workloads = 0;
+
+    for(int i = 1; i < argc; i++){
+        if(strncmp(argv[i], "--format=", 9) == 0){
+            char* format = argv[i] + 9;
+            if(strcmp(format, "text") == 0){formats = FORMAT_TEXT;}
+            else if(strcmp(format, "binary") == 0){formats = FORMAT_BINARY;}
+            else if(strcmp(format, "both") == 0){formats = FORMAT_TEXT | FORMAT_BINARY;}
+            else{
+                printf("Error: unknown format %s!\n", format);
+                exit(-1);
+            }
+            continue;
+        }
+        const workload_class* workload = find_workload_class(argv[i]);
+        if(workload == NULL){
+            printf("Error: unknown workload %s!\n", argv[i]);
+            exit(-1);
+        }
+        if(n_workloads < N_WORKLOAD_CLASSES){
+            workloads[n_workloads++] = workload;
+        }
+    }
+    if(n_workloads == 0){
+        workloads[n_workloads++] = find_workload_class((char*)WORKLOAD);
+    }
+
+    for(int i = 0; i < n_workloads; i++){
+        printf("Generating workload %s with %d threads\n", workloads[i]->name, threads);
+        generate_workload(workloads[i], formats);
+    }
     return 0;
 }
@@ -0,0 +1,127 @@
+// one region for all the large arrays, backed by 2 MB huge pages when possible:
+// explicit huge pages (MAP_HUGETLB), then transparent huge pages (madvise), then malloc.
+// Sub-allocations are 64-byte aligned and never freed one by one; allocations that do not
+// fit (or made while no arena exists) go to malloc, so arena_free() works on any pointer
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define ARENA_ALIGNMENT 64
+#define ARENA_HUGE_PAGE (2 * 1024 * 1024)
+
+#define ARENA_NONE 0
+#define ARENA_EXPLICIT_HUGE_PAGES 1
+#define ARENA_TRANSPARENT_HUGE_PAGES 2
+#define ARENA_MALLOC 3
+
+typedef struct{
+	char* base;
+	size_t size;
+	size_t used;
+	// start and length of the mapping (the transparent one is over-sized to align base)
+	void* mapping;
+	size_t mapping_size;
+	int backing;
+} arena_state;
+
+arena_state arena;
+
+// bytes an allocation of the given size takes in the arena
+size_t arena_size(size_t bytes){
+	return (bytes + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+// transparent huge pages are only used when the kernel allows them for madvise'd regions
+int arena_transparent_huge_pages(){
+	FILE* file = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+	if(file == NULL){
+		return 0;
+	}
+	char modes[128];
+	int enabled = (fgets(modes, sizeof(modes), file) != NULL) && (strstr(modes, "[never]") == NULL);
+	fclose(file);
+	return enabled;
+}
+
+void arena_create(size_t bytes){
+	size_t size = (bytes + ARENA_HUGE_PAGE - 1) / ARENA_HUGE_PAGE * ARENA_HUGE_PAGE;
+	memset(&arena, 0, sizeof(arena_state));
+
+	void* region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if(region != MAP_FAILED){
+		arena.mapping = region;
+		arena.mapping_size = size;
+		arena.base = (char*)region;
+		arena.backing = ARENA_EXPLICIT_HUGE_PAGES;
+	}
+	else if(arena_transparent_huge_pages()){
+		// one extra huge page to align the start of the region on a huge page boundary
+		region = mmap(NULL, size + ARENA_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(region != MAP_FAILED){
+			arena.mapping = region;
+			arena.mapping_size = size + ARENA_HUGE_PAGE;
+			arena.base = (char*)(((uintptr_t)region + ARENA_HUGE_PAGE - 1) & ~(uintptr_t)(ARENA_HUGE_PAGE - 1));
+			if(madvise(arena.base, size, MADV_HUGEPAGE) == 0){
+				arena.backing = ARENA_TRANSPARENT_HUGE_PAGES;
+			}
+			else{
+				munmap(arena.mapping, arena.mapping_size);
+				arena.mapping = NULL;
+			}
+		}
+	}
+	if(arena.backing == ARENA_NONE){
+		arena.base = (char*) aligned_alloc(ARENA_HUGE_PAGE, size);
+		if(arena.base == NULL){
+			printf("Error when trying to allocate the arena!\n");
+			exit(-1);
+		}
+		arena.backing = ARENA_MALLOC;
+	}
+	arena.size = size;
+	arena.used = 0;
+}
+
+void* arena_alloc(size_t bytes){
+	if(arena.backing != ARENA_NONE && arena.used + arena_size(bytes) <= arena.size){
+		void* pointer = arena.base + arena.used;
+		arena.used += arena_size(bytes);
+		return pointer;
+	}
+	return malloc(bytes);
+}
+
+void* arena_calloc(size_t n, size_t size){
+	void* pointer = arena_alloc(n * size);
+	memset(pointer, 0, n * size);
+	return pointer;
+}
+
+void arena_free(void* pointer){
+	if(arena.backing != ARENA_NONE && (char*)pointer >= arena.base && (char*)pointer < arena.base + arena.size){
+		return;
+	}
+	free(pointer);
+}
+
+void arena_destroy(){
+	if(arena.backing == ARENA_MALLOC){
+		free(arena.base);
+	}
+	else if(arena.backing != ARENA_NONE){
+		munmap(arena.mapping, arena.mapping_size);
+	}
+	memset(&arena, 0, sizeof(arena_state));
+}
+
+const char* arena_backing_name(){
+	switch(arena.backing){
+		case ARENA_EXPLICIT_HUGE_PAGES: return "explicit 2 MB huge pages";
+		case ARENA_TRANSPARENT_HUGE_PAGES: return "transparent huge pages";
+		case ARENA_MALLOC: return "malloc (no huge pages)";
+		default: return "none";
+	}
+}
+
+void arena_report(){
+	printf(" Arena: %.1f MB, %s\n", arena.size / (1024.0 * 1024.0), arena_backing_name());
+}
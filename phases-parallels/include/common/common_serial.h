@@ -2,64 +2,470 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <stdint.h>
+#include <pthread.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#if defined(TIMER_TSC) && defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#if defined(TIMER_PERF)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
 
 #define CPU_INFO_PATH "/proc/cpuinfo"
 #define NO_CPU_INFO "No info"
+// passed_verification of a run without a reference to check against
+#define VERIFICATION_NOT_PERFORMED -1
 #define PROFILING_SLOTS 64
 
-double start[PROFILING_SLOTS];
-double elapsed[PROFILING_SLOTS];
+// timers: regions 0 .. PROFILING_SLOTS - 1 are the numbered slots (timer_start(TIMER_TOTAL),
+// ...), the named ones (timer_region("iteration")) come after them. Every thread keeps its own
+// records and stack of open regions, so regions may nest (the inner time is subtracted from
+// the outer one's self time) and threads never share a record; reads add up all the threads.
+// Ticks are CLOCK_MONOTONIC_RAW nanoseconds, or with TSC=ON the calibrated time-stamp counter
+// when the cpu has an invariant one
+#define TIMER_NAMED_REGIONS 64
+#define TIMER_REGIONS (PROFILING_SLOTS + TIMER_NAMED_REGIONS)
+#define TIMER_STACK_DEPTH 32
+#define TIMER_MAX_THREADS 1024
+
+// hardware counters (PERF=ON): every thread opens one perf_event_open group, read at each
+// region start and stop; the events the kernel or the cpu do not support are left out. The
+// vector instructions are a raw event, FP_ARITH_INST_RETIRED (packed, 128 and 256 bits) on
+// Intel cpus unless KMEANS_PERF_VECTOR_EVENT gives another raw config
+#define TIMER_PERF_EVENTS 6
+#define TIMER_PERF_CYCLES 0
+#define TIMER_PERF_INSTRUCTIONS 1
+#define TIMER_PERF_L1D_MISSES 2
+#define TIMER_PERF_LLC_MISSES 3
+#define TIMER_PERF_BRANCH_MISSES 4
+#define TIMER_PERF_VECTOR 5
+#define TIMER_PERF_INTEL_VECTOR 0x3cc7
+
+typedef struct{
+	uint64_t elapsed;
+	uint64_t self;
+	long calls;
+	int open;
+#if defined(TIMER_PERF)
+	double counters[TIMER_PERF_EVENTS];
+#endif
+} timer_record;
+
+typedef struct{
+	int region;
+	uint64_t start;
+	uint64_t children;
+#if defined(TIMER_PERF)
+	double counters[TIMER_PERF_EVENTS];
+#endif
+} timer_frame;
+
+typedef struct{
+	timer_record records[TIMER_REGIONS];
+	timer_frame stack[TIMER_STACK_DEPTH];
+	int depth;
+#if defined(TIMER_PERF)
+	// group leader (-1 without counters) and each event's position in the group (-1 if absent)
+	int perf_fd;
+	int perf_index[TIMER_PERF_EVENTS];
+	int perf_n;
+#endif
+} timer_thread;
+
+timer_thread* timer_threads[TIMER_MAX_THREADS];
+int timer_n_threads;
+char timer_region_names[TIMER_NAMED_REGIONS][32];
+int timer_n_regions;
+pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+__thread timer_thread* timer_self;
+double timer_tick_seconds;
+int timer_tsc;
+#if defined(TIMER_PERF)
+// events counted by at least one thread
+int timer_perf_counted[TIMER_PERF_EVENTS];
+#endif
+
+// structured report: with KMEANS_REPORT_FILE set, execution_report() appends one record to
+// it, a JSON line or (KMEANS_REPORT_FORMAT=csv, or a .csv file) a CSV row with a header
+// when the file is empty. The record has the run (application, workload, time,
+// verification, flags, host, cpu, kernel, timestamp), the fields the application adds
+// with report_integer/report_number/report_text (sizes, ranks, threads, iterations, ...),
+// the named timer slots, the named regions and their counters
+#define REPORT_FIELDS 512
+
+typedef struct{
+	char key[64];
+	char value[128];
+	int text;
+} report_field;
+
+report_field report_fields[REPORT_FIELDS];
+int report_n_fields;
+char timer_slot_names[PROFILING_SLOTS][32];
+
+#if defined(ROOFLINE)
+// roofline (ROOFLINE=ON, which turns the timers on): the application gives every phase its
+// analytical counts with roofline_phase() (flops of the distances and sums, bytes that reach
+// memory: the points streamed, the means and sums only when roofline_memory_bytes() finds them
+// larger than the last-level cache) and the peaks of its processing units with roofline_peak(),
+// the sum of roofline_probe() over its threads and processes; execution_report() prints the
+// GFLOP/s and GB/s of each phase, their fraction of the peaks and of the roof at the phase's
+// arithmetic intensity, and adds them to the structured report. A phase above the memory roof
+// runs from the caches: it is flagged as such and its fractions are capped at 100%
+#define ROOFLINE_PHASES 16
+// doubles of each STREAM triad array (at least, see roofline_stream_length()), split among the
+// threads probing on the same node
+#define ROOFLINE_STREAM_LENGTH (1 << 22)
+#define ROOFLINE_MIN_LENGTH (1 << 16)
+#define ROOFLINE_REPETITIONS 5
+// independent multiply-add chains (enough to hide the latency of the floating-point units)
+#define ROOFLINE_CHAINS 32
+#define ROOFLINE_STEPS (1 << 18)
+
+typedef struct{
+	char name[32];
+	double flops;
+	double bytes;
+	double seconds;
+} roofline_record;
+
+roofline_record roofline_records[ROOFLINE_PHASES];
+int roofline_n_phases;
+double roofline_peak_flops;
+double roofline_peak_bytes;
+volatile double roofline_sink;
+#endif
+
 int debug_flag;
 int timer_flag;
 char timer_string[2048];
 char checksum_string[8192];
 char cpu_name[256];
 
-void timer_write_time(double* t);
+uint64_t timer_ticks();
 double timer_elapsed_time();
 void timer_clear(int n);
 void timer_start(int n);
 void timer_stop(int n);
 double timer_read(int n);
+int timer_region(const char* name);
+void timer_region_start(int region);
+void timer_region_stop(int region);
+double timer_region_read(int region);
+double timer_region_self(int region);
+#if defined(TIMER_PERF)
+double timer_region_counter(int region, int event);
+#endif
+long timer_region_calls(int region);
 void activate_debug_flag();
 void activate_timer_flag();
 void get_cpu_model();
+void timer_name(int n, const char* name);
+void report_text(const char* key, const char* value);
+void report_integer(const char* key, long value);
+void report_number(const char* key, double value);
+FILE* report_csv_open(const char* file_name);
+void report_write(char* application_name, char* workload, double execution_time, int passed_verification);
 void execution_report(char* application_name, char* workload, double execution_time, int passed_verification);
 void setup_common();
+#if defined(ROOFLINE)
+double roofline_cache_bytes();
+long roofline_stream_length();
+double roofline_memory_bytes(double bytes, double footprint);
+void roofline_probe(long length, double* flops, double* bytes);
+void roofline_peak(double flops, double bytes);
+void roofline_phase(const char* name, double flops, double bytes, double seconds);
+#endif
+
+uint64_t timer_clock_ticks(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t timer_ticks(){
+#if defined(TIMER_TSC) && defined(__x86_64__)
+	if(timer_tsc){
+		return __rdtsc();
+	}
+#endif
+	return timer_clock_ticks();
+}
+
+// with TSC=ON: the counter is used only if it is invariant (constant_tsc and nonstop_tsc),
+// its period is measured against CLOCK_MONOTONIC_RAW over 20 ms
+void timer_calibrate(){
+	timer_tick_seconds = 1.0e-9;
+	timer_tsc = 0;
+#if defined(TIMER_TSC) && defined(__x86_64__)
+	FILE* file = fopen((char*)CPU_INFO_PATH, "r");
+	char* line = NULL;
+	size_t n = 0;
+	int invariant = 0;
+	if(file != NULL){
+		while(getline(&line, &n, file) > 0){
+			if(strncmp(line, "flags", 5) == 0){
+				invariant = strstr(line, " constant_tsc") != NULL && strstr(line, " nonstop_tsc") != NULL;
+				break;
+			}
+		}
+		free(line);
+		fclose(file);
+	}
+	if(invariant){
+		uint64_t clock_begin = timer_clock_ticks();
+		uint64_t tsc_begin = __rdtsc();
+		while(timer_clock_ticks() - clock_begin < 20000000ull);
+		uint64_t clock_end = timer_clock_ticks();
+		uint64_t tsc_end = __rdtsc();
+		timer_tick_seconds = 1.0e-9 * (double)(clock_end - clock_begin) / (double)(tsc_end - tsc_begin);
+		timer_tsc = 1;
+	}
+#endif
+}
+
+#if defined(TIMER_PERF)
+// attributes of an event: user-space counts of the calling thread, on any cpu
+int timer_perf_attributes(int event, struct perf_event_attr* attributes){
+	memset(attributes, 0, sizeof(struct perf_event_attr));
+	attributes->size = sizeof(struct perf_event_attr);
+	attributes->exclude_kernel = 1;
+	attributes->exclude_hv = 1;
+	attributes->read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	switch(event){
+		case TIMER_PERF_CYCLES:
+			attributes->type = PERF_TYPE_HARDWARE;
+			attributes->config = PERF_COUNT_HW_CPU_CYCLES;
+			return 1;
+		case TIMER_PERF_INSTRUCTIONS:
+			attributes->type = PERF_TYPE_HARDWARE;
+			attributes->config = PERF_COUNT_HW_INSTRUCTIONS;
+			return 1;
+		case TIMER_PERF_L1D_MISSES:
+			attributes->type = PERF_TYPE_HW_CACHE;
+			attributes->config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			return 1;
+		case TIMER_PERF_LLC_MISSES:
+			attributes->type = PERF_TYPE_HARDWARE;
+			attributes->config = PERF_COUNT_HW_CACHE_MISSES;
+			return 1;
+		case TIMER_PERF_BRANCH_MISSES:
+			attributes->type = PERF_TYPE_HARDWARE;
+			attributes->config = PERF_COUNT_HW_BRANCH_MISSES;
+			return 1;
+		default:{
+			char* raw = getenv("KMEANS_PERF_VECTOR_EVENT");
+			attributes->type = PERF_TYPE_RAW;
+			if(raw != NULL){
+				attributes->config = strtoull(raw, NULL, 16);
+				return 1;
+			}
+			attributes->config = TIMER_PERF_INTEL_VECTOR;
+			if(cpu_name[0] == '\0'){
+				get_cpu_model();
+			}
+			return strstr(cpu_name, "Intel") != NULL;
+		}
+	}
+}
+
+void timer_perf_open(timer_thread* self){
+	self->perf_fd = -1;
+	self->perf_n = 0;
+	for(int e = 0; e < TIMER_PERF_EVENTS; e++){
+		self->perf_index[e] = -1;
+		struct perf_event_attr attributes;
+		if(!timer_perf_attributes(e, &attributes)){
+			continue;
+		}
+		int fd = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, self->perf_fd, 0);
+		if(fd < 0){
+			continue;
+		}
+		if(self->perf_fd < 0){
+			self->perf_fd = fd;
+		}
+		self->perf_index[e] = self->perf_n++;
+		timer_perf_counted[e] = 1;
+	}
+}
+
+// current counts of the thread, scaled up if the group was multiplexed
+void timer_perf_read(timer_thread* self, double* counters){
+	uint64_t values[3 + TIMER_PERF_EVENTS];
+	int valid = self->perf_fd >= 0 && read(self->perf_fd, values, sizeof(values)) >= (ssize_t)((3 + self->perf_n) * sizeof(uint64_t));
+	double scale = (valid && values[2] > 0) ? (double)values[1] / (double)values[2] : 1.0;
+	for(int e = 0; e < TIMER_PERF_EVENTS; e++){
+		counters[e] = (valid && self->perf_index[e] >= 0) ? scale * values[3 + self->perf_index[e]] : 0.0;
+	}
+}
+#endif
 
-void timer_write_time(double* t){
-	static int sec = -1;
-	struct timeval tv;
-	gettimeofday(&tv, 0);
-	if (sec < 0) sec = tv.tv_sec;
-	*t = (tv.tv_sec - sec) + 1.0e-6*tv.tv_usec;
+// records of the calling thread, registered on its first use
+timer_thread* timer_thread_self(){
+	if(timer_self == NULL){
+		pthread_once(&timer_once, timer_calibrate);
+		timer_self = (timer_thread*) calloc(1, sizeof(timer_thread));
+#if defined(TIMER_PERF)
+		timer_perf_open(timer_self);
+#endif
+		pthread_mutex_lock(&timer_lock);
+		if(timer_n_threads == TIMER_MAX_THREADS){
+			printf("Error: too many threads using the timers!\n");
+			exit(-1);
+		}
+		timer_threads[timer_n_threads++] = timer_self;
+		pthread_mutex_unlock(&timer_lock);
+	}
+	return timer_self;
 }
 
 double timer_elapsed_time(){
-	double t;
-	timer_write_time(&t);
-	return(t);
+	timer_thread_self();
+	return timer_ticks() * timer_tick_seconds;
+}
+
+// id of the named region, registered on its first use (look it up once, outside the loops)
+int timer_region(const char* name){
+	pthread_mutex_lock(&timer_lock);
+	int region = -1;
+	for(int r = 0; r < timer_n_regions; r++){
+		if(strncmp(timer_region_names[r], name, sizeof(timer_region_names[r]) - 1) == 0){
+			region = PROFILING_SLOTS + r;
+		}
+	}
+	if(region < 0){
+		if(timer_n_regions == TIMER_NAMED_REGIONS){
+			printf("Error: too many timer regions!\n");
+			exit(-1);
+		}
+		snprintf(timer_region_names[timer_n_regions], sizeof(timer_region_names[0]), "%s", name);
+		region = PROFILING_SLOTS + timer_n_regions++;
+	}
+	pthread_mutex_unlock(&timer_lock);
+	return region;
+}
+
+void timer_region_start(int region){
+	timer_thread* self = timer_thread_self();
+	if(self->depth == TIMER_STACK_DEPTH){
+		printf("Error: timer regions nested too deep!\n");
+		exit(-1);
+	}
+	timer_frame* frame = &self->stack[self->depth++];
+	frame->region = region;
+	frame->children = 0;
+	self->records[region].open++;
+#if defined(TIMER_PERF)
+	timer_perf_read(self, frame->counters);
+#endif
+	frame->start = timer_ticks();
+}
+
+// regions close in the reverse order they were opened
+void timer_region_stop(int region){
+	uint64_t now = timer_ticks();
+	timer_thread* self = timer_thread_self();
+#if defined(TIMER_PERF)
+	double counters[TIMER_PERF_EVENTS];
+	timer_perf_read(self, counters);
+#endif
+	if(self->depth == 0 || self->stack[self->depth - 1].region != region){
+		printf("Error: timer region %d stopped out of order!\n", region);
+		exit(-1);
+	}
+	timer_frame* frame = &self->stack[--self->depth];
+	uint64_t inclusive = now - frame->start;
+	timer_record* record = &self->records[region];
+	record->calls++;
+	record->self += inclusive - frame->children;
+	// a region nested in itself is only counted once, by its outermost instance
+	if(--record->open == 0){
+		record->elapsed += inclusive;
+#if defined(TIMER_PERF)
+		for(int e = 0; e < TIMER_PERF_EVENTS; e++){
+			record->counters[e] += counters[e] - frame->counters[e];
+		}
+#endif
+	}
+	if(self->depth > 0){
+		self->stack[self->depth - 1].children += inclusive;
+	}
+}
+
+// seconds in the region, over all the threads
+double timer_region_read(int region){
+	uint64_t ticks = 0;
+	pthread_mutex_lock(&timer_lock);
+	for(int t = 0; t < timer_n_threads; t++){
+		ticks += timer_threads[t]->records[region].elapsed;
+	}
+	pthread_mutex_unlock(&timer_lock);
+	return ticks * timer_tick_seconds;
+}
+
+double timer_region_self(int region){
+	uint64_t ticks = 0;
+	pthread_mutex_lock(&timer_lock);
+	for(int t = 0; t < timer_n_threads; t++){
+		ticks += timer_threads[t]->records[region].self;
+	}
+	pthread_mutex_unlock(&timer_lock);
+	return ticks * timer_tick_seconds;
+}
+
+#if defined(TIMER_PERF)
+// events counted in the region, over all the threads
+double timer_region_counter(int region, int event){
+	double count = 0.0;
+	pthread_mutex_lock(&timer_lock);
+	for(int t = 0; t < timer_n_threads; t++){
+		count += timer_threads[t]->records[region].counters[event];
+	}
+	pthread_mutex_unlock(&timer_lock);
+	return count;
+}
+#endif
+
+long timer_region_calls(int region){
+	long calls = 0;
+	pthread_mutex_lock(&timer_lock);
+	for(int t = 0; t < timer_n_threads; t++){
+		calls += timer_threads[t]->records[region].calls;
+	}
+	pthread_mutex_unlock(&timer_lock);
+	return calls;
 }
 
 void timer_clear(int n){
-	elapsed[n] = 0.0;
+	timer_thread_self();
+	pthread_mutex_lock(&timer_lock);
+	for(int t = 0; t < timer_n_threads; t++){
+		timer_threads[t]->records[n].elapsed = 0;
+		timer_threads[t]->records[n].self = 0;
+		timer_threads[t]->records[n].calls = 0;
+#if defined(TIMER_PERF)
+		memset(timer_threads[t]->records[n].counters, 0, sizeof(timer_threads[t]->records[n].counters));
+#endif
+	}
+	pthread_mutex_unlock(&timer_lock);
 }
 
 void timer_start(int n){
-	start[n] = timer_elapsed_time();
+	timer_region_start(n);
 }
 
 void timer_stop(int n){
-	double t, now;
-	now = timer_elapsed_time();
-	t = now - start[n];
-	elapsed[n] += t;
+	timer_region_stop(n);
 }
 
 double timer_read(int n){
-	return(elapsed[n]);
+	return timer_region_read(n);
 }
 
 void activate_debug_flag(){
@@ -77,7 +483,7 @@ void activate_timer_flag(){
 	timer_flag = 0;
 
 	/* activating the timer flag through a macro */
-#if defined(TIMER)
+#if defined(TIMER) || defined(ROOFLINE)
 	timer_flag = 1;	
 #endif
 }
@@ -111,6 +517,298 @@ void get_cpu_model(){
 	strcpy(cpu_name, error);
 }
 
+// name of a numbered slot in the structured report (unnamed slots are left out)
+void timer_name(int n, const char* name){
+	snprintf(timer_slot_names[n], sizeof(timer_slot_names[n]), "%s", name);
+}
+
+void report_text(const char* key, const char* value){
+	if(report_n_fields == REPORT_FIELDS){
+		return;
+	}
+	report_field* field = &report_fields[report_n_fields++];
+	snprintf(field->key, sizeof(field->key), "%s", key);
+	snprintf(field->value, sizeof(field->value), "%.*s", (int)sizeof(field->value) - 1, value);
+	field->text = 1;
+}
+
+void report_integer(const char* key, long value){
+	char text[32];
+	sprintf(text, "%ld", value);
+	report_text(key, text);
+	report_fields[report_n_fields - 1].text = 0;
+}
+
+void report_number(const char* key, double value){
+	char text[32];
+	// JSON has no inf/nan
+	if(isfinite(value)){
+		sprintf(text, "%.9g", value);
+	}
+	else{
+		strcpy(text, "null");
+	}
+	report_text(key, text);
+	report_fields[report_n_fields - 1].text = 0;
+}
+
+#if defined(ROOFLINE)
+// bytes of the last-level cache (L3, or L2 without one), 0 when the system does not tell
+double roofline_cache_bytes(){
+	long bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+	if(bytes <= 0){
+		bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	}
+	return (bytes > 0) ? (double)bytes : 0.0;
+}
+
+// doubles of each triad array of a node: enough for the three arrays to take twice the
+// last-level cache, so the probe measures the memory and not the cache
+long roofline_stream_length(){
+	long length = (long)(2.0 * roofline_cache_bytes() / (3 * sizeof(double)));
+	return (length > ROOFLINE_STREAM_LENGTH) ? length : ROOFLINE_STREAM_LENGTH;
+}
+
+// bytes a phase moves over data it rereads every iteration (the means, the sums), footprint
+// bytes of which share a last-level cache: they only reach memory when they do not fit in it
+double roofline_memory_bytes(double bytes, double footprint){
+	return (footprint > roofline_cache_bytes()) ? bytes : 0.0;
+}
+
+// peaks of the calling thread: the best of ROOFLINE_REPETITIONS STREAM triads (a = b + s * c,
+// 24 bytes per element) over length elements, and the best of as many runs of multiply-adds
+// on ROOFLINE_CHAINS independent chains (2 flops each); both are what the build's instruction
+// set reaches, the bandwidth shared with the threads probing at the same time
+void roofline_probe(long length, double* flops, double* bytes){
+	length = (length > ROOFLINE_MIN_LENGTH) ? length : ROOFLINE_MIN_LENGTH;
+	double* a = (double*) malloc(3 * length * sizeof(double));
+	if(a == NULL){
+		printf("Error when trying to allocate the roofline probe!\n");
+		exit(-1);
+	}
+	double* b = a + length;
+	double* c = b + length;
+	for(long i = 0; i < length; i++){
+		a[i] = 0.0;
+		b[i] = 1.0;
+		c[i] = 2.0;
+	}
+
+	double best = 0.0;
+	for(int r = 0; r < ROOFLINE_REPETITIONS; r++){
+		double start = timer_elapsed_time();
+		for(long i = 0; i < length; i++){
+			a[i] = b[i] + 3.0 * c[i];
+		}
+		double elapsed = timer_elapsed_time() - start;
+		best = (r == 0 || elapsed < best) ? elapsed : best;
+		roofline_sink += a[(r * 7919L) % length];
+	}
+	*bytes = 3.0 * sizeof(double) * length / best;
+
+	double chains[ROOFLINE_CHAINS];
+	for(int j = 0; j < ROOFLINE_CHAINS; j++){
+		chains[j] = a[j] + 1.0e-3 * j;
+	}
+	for(int r = 0; r < ROOFLINE_REPETITIONS; r++){
+		double start = timer_elapsed_time();
+		for(int step = 0; step < ROOFLINE_STEPS; step++){
+			for(int j = 0; j < ROOFLINE_CHAINS; j++){
+				chains[j] = chains[j] * 0.999999 + 1.0e-6;
+			}
+		}
+		double elapsed = timer_elapsed_time() - start;
+		best = (r == 0 || elapsed < best) ? elapsed : best;
+	}
+	*flops = 2.0 * ROOFLINE_CHAINS * ROOFLINE_STEPS / best;
+	for(int j = 0; j < ROOFLINE_CHAINS; j++){
+		roofline_sink += chains[j];
+	}
+	free(a);
+}
+
+// peaks of every processing unit of the run, in flops and bytes per second
+void roofline_peak(double flops, double bytes){
+	roofline_peak_flops = flops;
+	roofline_peak_bytes = bytes;
+}
+
+// analytical counts of a phase over the whole run and its measured time
+void roofline_phase(const char* name, double flops, double bytes, double seconds){
+	if(roofline_n_phases == ROOFLINE_PHASES){
+		return;
+	}
+	roofline_record* record = &roofline_records[roofline_n_phases++];
+	snprintf(record->name, sizeof(record->name), "%s", name);
+	record->flops = flops;
+	record->bytes = bytes;
+	record->seconds = seconds;
+}
+#endif
+
+// text value quoted for JSON, or for CSV (quotes doubled)
+void report_quote(FILE* file, const char* value, int csv){
+	fputc('"', file);
+	for(const char* c = value; *c != '\0'; c++){
+		if(*c == '"'){
+			fputs(csv ? "\"\"" : "\\\"", file);
+		}
+		else if(*c == '\\' && !csv){
+			fputs("\\\\", file);
+		}
+		else if((unsigned char)*c >= ' '){
+			fputc(*c, file);
+		}
+	}
+	fputc('"', file);
+}
+
+// CSV file for the run's fields: file_name when it is empty or its header has the same keys,
+// else the first of its siblings (tempos.1.csv, tempos.2.csv, ...) that is; runs with other
+// fields (TIMER, TRACE, PERF, regions) never append rows under another run's columns
+FILE* report_csv_open(const char* file_name){
+	size_t size = (size_t)report_n_fields * (sizeof(report_fields[0].key) + 1) + 2;
+	char* header = (char*) malloc(size);
+	size_t used = 0;
+	header[0] = '\0';
+	for(int f = 0; f < report_n_fields; f++){
+		used += snprintf(header + used, size - used, "%s%s", (f > 0) ? "," : "", report_fields[f].key);
+	}
+	snprintf(header + used, size - used, "\n");
+
+	const char* extension = strrchr(file_name, '.');
+	if(extension == NULL || strchr(extension, '/') != NULL){
+		extension = file_name + strlen(file_name);
+	}
+	char name[4096];
+	char* line = NULL;
+	size_t n = 0;
+	FILE* file = NULL;
+	for(int sibling = 0; ; sibling++){
+		if(sibling == 0){
+			snprintf(name, sizeof(name), "%s", file_name);
+		}
+		else{
+			snprintf(name, sizeof(name), "%.*s.%d%s", (int)(extension - file_name), file_name, sibling, extension);
+		}
+		file = fopen(name, "a+");
+		if(file == NULL){
+			break;
+		}
+		// reads start at the beginning, writes still append
+		fseek(file, 0, SEEK_SET);
+		if(getline(&line, &n, file) <= 0){
+			fputs(header, file);
+			break;
+		}
+		if(strcmp(line, header) == 0){
+			break;
+		}
+		fclose(file);
+	}
+	if(file != NULL && strcmp(name, file_name) != 0){
+		printf(" The report fields differ from the header of %s, writing them to %s\n", file_name, name);
+	}
+	free(line);
+	free(header);
+	return file;
+}
+
+void report_write(char* application_name, char* workload, double execution_time, int passed_verification){
+	char* file_name = getenv("KMEANS_REPORT_FILE");
+	if(file_name == NULL || file_name[0] == '\0'){
+		return;
+	}
+	char* format = getenv("KMEANS_REPORT_FORMAT");
+	size_t length = strlen(file_name);
+	int csv = (format != NULL) ? (strcmp(format, "csv") == 0) : (length > 4 && strcmp(file_name + length - 4, ".csv") == 0);
+
+	// the application's fields go after the run's and before the timers
+	int n_application = report_n_fields;
+	report_field* application = (report_field*) malloc((n_application + 1) * sizeof(report_field));
+	memcpy(application, report_fields, n_application * sizeof(report_field));
+	report_n_fields = 0;
+
+	char host[256] = "";
+	gethostname(host, sizeof(host) - 1);
+	struct utsname system;
+	report_text("application", application_name);
+	report_text("workload", workload);
+	report_number("execution_time", execution_time);
+	report_text("verification", (passed_verification == 1) ? "SUCCESSFUL" :
+		(passed_verification == VERIFICATION_NOT_PERFORMED) ? "NOT PERFORMED" : "UNSUCCESSFUL");
+	report_integer("debug", debug_flag);
+	report_integer("timer", timer_flag);
+	report_text("host", host);
+	report_text("cpu", cpu_name);
+	report_text("kernel", (uname(&system) == 0) ? system.release : "");
+	report_integer("timestamp", (long)time(NULL));
+	for(int f = 0; f < n_application && report_n_fields < REPORT_FIELDS; f++){
+		report_fields[report_n_fields++] = application[f];
+	}
+	free(application);
+
+	char key[64];
+	for(int n = 0; n < PROFILING_SLOTS; n++){
+		if(timer_slot_names[n][0] != '\0'){
+			snprintf(key, sizeof(key), "timer_%.31s", timer_slot_names[n]);
+			report_number(key, timer_read(n));
+		}
+	}
+	for(int r = 0; r < timer_n_regions; r++){
+		int region = PROFILING_SLOTS + r;
+		snprintf(key, sizeof(key), "region_%.31s_calls", timer_region_names[r]);
+		report_integer(key, timer_region_calls(region));
+		snprintf(key, sizeof(key), "region_%.31s_time", timer_region_names[r]);
+		report_number(key, timer_region_read(region));
+		snprintf(key, sizeof(key), "region_%.31s_self", timer_region_names[r]);
+		report_number(key, timer_region_self(region));
+#if defined(TIMER_PERF)
+		const char* events[TIMER_PERF_EVENTS] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "vector"};
+		for(int e = 0; e < TIMER_PERF_EVENTS; e++){
+			if(timer_perf_counted[e]){
+				snprintf(key, sizeof(key), "region_%.31s_%s", timer_region_names[r], events[e]);
+				report_number(key, timer_region_counter(region, e));
+			}
+		}
+#endif
+	}
+
+	FILE* file = csv ? report_csv_open(file_name) : fopen(file_name, "a");
+	if(file == NULL){
+		printf("Error when trying to write the report %s!\n", file_name);
+		return;
+	}
+	if(csv){
+		for(int f = 0; f < report_n_fields; f++){
+			if(f > 0){
+				fputc(',', file);
+			}
+			if(report_fields[f].text){
+				report_quote(file, report_fields[f].value, 1);
+			}
+			else{
+				fputs(strcmp(report_fields[f].value, "null") == 0 ? "" : report_fields[f].value, file);
+			}
+		}
+	}
+	else{
+		fputc('{', file);
+		for(int f = 0; f < report_n_fields; f++){
+			fprintf(file, "%s\"%s\":", (f > 0) ? "," : "", report_fields[f].key);
+			if(report_fields[f].text){
+				report_quote(file, report_fields[f].value, 0);
+			}
+			else{
+				fputs(report_fields[f].value, file);
+			}
+		}
+		fputc('}', file);
+	}
+	fputc('\n', file);
+	fclose(file);
+}
+
 void execution_report(char* application_name, char* workload, double execution_time, int passed_verification){
 	printf("----------------------------------------------------------------------------\n");
 	printf(" %s:\n", application_name);
@@ -120,6 +818,9 @@ void execution_report(char* application_name, char* workload, double execution_t
 	if(passed_verification == 1){
 		printf(" Correctness verification  =     SUCCESSFUL\n");
 	}
+	else if(passed_verification == VERIFICATION_NOT_PERFORMED){
+		printf(" Correctness verification  =     NOT PERFORMED\n");
+	}
 	else{
 		printf(" Correctness verification  =     UNSUCCESSFUL\n");
 	}
@@ -143,6 +844,109 @@ void execution_report(char* application_name, char* workload, double execution_t
 		printf("%s\n", timer_string);
 		printf("----------------------------------------------------------------------------\n");
 	}
+	if(timer_flag && timer_n_regions > 0){
+		printf(" Regions:\n");
+		printf("\n");
+		printf("%25s\t%10s\t%14s\t%14s\t%14s\n", "Region", "Calls", "Total (s)", "Self (s)", "Per call (us)");
+		for(int r = 0; r < timer_n_regions; r++){
+			int region = PROFILING_SLOTS + r;
+			long calls = timer_region_calls(region);
+			printf("%25s\t%10ld\t%14f\t%14f\t%14.3f\n", timer_region_names[r], calls, timer_region_read(region),
+				timer_region_self(region), (calls > 0) ? 1.0e6 * timer_region_read(region) / calls : 0.0);
+		}
+		printf(" Clock                     =     %s\n", timer_tsc ? "calibrated TSC" : "CLOCK_MONOTONIC_RAW");
+		printf("----------------------------------------------------------------------------\n");
+#if defined(TIMER_PERF)
+		// misses per thousand instructions; a region with a low IPC and a high LLC MPKI is
+		// waiting on memory, one with a high IPC (and vector share) is compute-bound
+		printf(" Counters:\n");
+		printf("\n");
+		printf("%25s\t%14s\t%14s\t%8s\t%10s\t%10s\t%10s\t%10s\n", "Region", "Cycles", "Instructions", "IPC",
+			"L1D MPKI", "LLC MPKI", "Br. MPKI", "Vector %");
+		for(int r = 0; r < timer_n_regions; r++){
+			int region = PROFILING_SLOTS + r;
+			double counts[TIMER_PERF_EVENTS];
+			for(int e = 0; e < TIMER_PERF_EVENTS; e++){
+				counts[e] = timer_region_counter(region, e);
+			}
+			char cells[TIMER_PERF_EVENTS + 1][32];
+			double instructions = counts[TIMER_PERF_INSTRUCTIONS];
+			int have_instructions = timer_perf_counted[TIMER_PERF_INSTRUCTIONS] && instructions > 0.0;
+			for(int e = 0; e < TIMER_PERF_EVENTS; e++){
+				if(!timer_perf_counted[e] || (e >= TIMER_PERF_L1D_MISSES && !have_instructions)){
+					strcpy(cells[e], "n/a");
+				}
+				else if(e <= TIMER_PERF_INSTRUCTIONS){
+					sprintf(cells[e], "%.0f", counts[e]);
+				}
+				else if(e == TIMER_PERF_VECTOR){
+					sprintf(cells[e], "%.2f", 100.0 * counts[e] / instructions);
+				}
+				else{
+					sprintf(cells[e], "%.3f", 1000.0 * counts[e] / instructions);
+				}
+			}
+			if(timer_perf_counted[TIMER_PERF_CYCLES] && have_instructions && counts[TIMER_PERF_CYCLES] > 0.0){
+				sprintf(cells[TIMER_PERF_EVENTS], "%.2f", instructions / counts[TIMER_PERF_CYCLES]);
+			}
+			else{
+				strcpy(cells[TIMER_PERF_EVENTS], "n/a");
+			}
+			printf("%25s\t%14s\t%14s\t%8s\t%10s\t%10s\t%10s\t%10s\n", timer_region_names[r], cells[TIMER_PERF_CYCLES],
+				cells[TIMER_PERF_INSTRUCTIONS], cells[TIMER_PERF_EVENTS], cells[TIMER_PERF_L1D_MISSES],
+				cells[TIMER_PERF_LLC_MISSES], cells[TIMER_PERF_BRANCH_MISSES], cells[TIMER_PERF_VECTOR]);
+		}
+		printf("----------------------------------------------------------------------------\n");
+#endif
+	}
+#if defined(ROOFLINE)
+	if(roofline_n_phases > 0){
+		// the roof at a phase's intensity I is min(peak flops, I * peak bandwidth): a phase
+		// left of the ridge is memory-bound, and its distance to the roof is the headroom. A
+		// phase above it, or without memory traffic, works on cached data: the memory roof does
+		// not bound it, so it is flagged and its fractions capped
+		double ridge = (roofline_peak_bytes > 0.0) ? roofline_peak_flops / roofline_peak_bytes : 0.0;
+		printf(" Roofline:\n");
+		printf("\n");
+		printf(" Peak                      =     %.3f GFLOP/s, %.3f GB/s (ridge at %.3f flops/byte)\n",
+			roofline_peak_flops * 1.0e-9, roofline_peak_bytes * 1.0e-9, ridge);
+		printf(" Last-level cache          =     %.3f MB\n", roofline_cache_bytes() * 1.0e-6);
+		printf("%25s\t%12s\t%12s\t%10s\t%10s\t%10s\t%10s\t%10s\t%8s\t%8s\n", "Phase", "GFLOP", "GB", "Flops/B",
+			"GFLOP/s", "GB/s", "% peak F", "% peak B", "% roof", "Bound");
+		char key[64];
+		report_number("roofline_peak_gflops", roofline_peak_flops * 1.0e-9);
+		report_number("roofline_peak_gbs", roofline_peak_bytes * 1.0e-9);
+		report_number("roofline_cache_mb", roofline_cache_bytes() * 1.0e-6);
+		for(int p = 0; p < roofline_n_phases; p++){
+			const roofline_record* record = &roofline_records[p];
+			double seconds = (record->seconds > 0.0) ? record->seconds : NAN;
+			double flops = record->flops / seconds, bytes = record->bytes / seconds;
+			double intensity = (record->bytes > 0.0) ? record->flops / record->bytes : 0.0;
+			double roof = (record->bytes > 0.0 && intensity < ridge) ? intensity * roofline_peak_bytes : roofline_peak_flops;
+			// the bound of a phase without flops is the data it moves
+			double fraction = (record->flops > 0.0) ? flops / roof : bytes / roofline_peak_bytes;
+			int cached = (record->bytes <= 0.0 || fraction > 1.0 || bytes > roofline_peak_bytes);
+			fraction = fmin(fraction, 1.0);
+			printf("%25s\t%12.3f\t%12.3f\t%10.3f\t%10.3f\t%10.3f\t%10.2f\t%10.2f\t%8.2f\t%8s\n", record->name,
+				record->flops * 1.0e-9, record->bytes * 1.0e-9, intensity, flops * 1.0e-9, bytes * 1.0e-9,
+				fmin(100.0 * flops / roofline_peak_flops, 100.0), fmin(100.0 * bytes / roofline_peak_bytes, 100.0),
+				100.0 * fraction, cached ? "cache" : (record->flops > 0.0 && intensity >= ridge) ? "compute" : "memory");
+
+			snprintf(key, sizeof(key), "roofline_%.31s_gflops", record->name);
+			report_number(key, flops * 1.0e-9);
+			snprintf(key, sizeof(key), "roofline_%.31s_gbs", record->name);
+			report_number(key, bytes * 1.0e-9);
+			snprintf(key, sizeof(key), "roofline_%.31s_intensity", record->name);
+			report_number(key, intensity);
+			snprintf(key, sizeof(key), "roofline_%.31s_roof", record->name);
+			report_number(key, fraction);
+			snprintf(key, sizeof(key), "roofline_%.31s_cache", record->name);
+			report_number(key, cached);
+		}
+		printf("----------------------------------------------------------------------------\n");
+	}
+#endif
+	report_write(application_name, workload, execution_time, passed_verification);
 }
 
 void setup_common(){
@@ -0,0 +1,60 @@
+// per-phase timers of the MPI variants: every rank accumulates its own time in the
+// common_serial.h slots, and the report shows each phase's min, avg and max over the ranks,
+// so a phase that is slow everywhere (communication) stands apart from one that is slow on a
+// few ranks (imbalance, max/avg well above 1)
+#include <mpi.h>
+
+typedef struct{
+	int timer;
+	const char* name;
+} phase_timer;
+
+double phase_min[PROFILING_SLOTS];
+double phase_avg[PROFILING_SLOTS];
+double phase_max[PROFILING_SLOTS];
+
+// collective: min, avg and max of every phase, valid on the root only
+void phase_timers_reduce(const phase_timer* phases, int n_phases, int root){
+	if(!timer_flag){
+		return;
+	}
+	int nprocs;
+	MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+	double local[PROFILING_SLOTS], minimum[PROFILING_SLOTS], sum[PROFILING_SLOTS], maximum[PROFILING_SLOTS];
+	for(int p = 0; p < n_phases; p++){
+		local[p] = timer_read(phases[p].timer);
+	}
+	MPI_Reduce(local, minimum, n_phases, MPI_DOUBLE, MPI_MIN, root, MPI_COMM_WORLD);
+	MPI_Reduce(local, sum, n_phases, MPI_DOUBLE, MPI_SUM, root, MPI_COMM_WORLD);
+	MPI_Reduce(local, maximum, n_phases, MPI_DOUBLE, MPI_MAX, root, MPI_COMM_WORLD);
+	for(int p = 0; p < n_phases; p++){
+		phase_min[phases[p].timer] = minimum[p];
+		phase_avg[phases[p].timer] = sum[p] / nprocs;
+		phase_max[phases[p].timer] = maximum[p];
+	}
+}
+
+// root: appends the per-phase table to the timers of execution_report()
+void phase_timers_append(const phase_timer* phases, int n_phases){
+	if(!timer_flag){
+		return;
+	}
+	char timer_string_aux[256];
+	sprintf(timer_string_aux, "%s%25s\t%14s\t%14s\t%14s\t%10s", (timer_string[0] != '\0') ? "\n\n" : "", "Phase (per rank)", "Min (s)", "Avg (s)", "Max (s)", "Max/Avg");
+	strcat(timer_string, timer_string_aux);
+	for(int p = 0; p < n_phases; p++){
+		int t = phases[p].timer;
+		sprintf(timer_string_aux, "\n%25s\t%14f\t%14f\t%14f\t%10.2f", phases[p].name, phase_min[t], phase_avg[t], phase_max[t],
+			(phase_avg[t] > 0.0) ? phase_max[t] / phase_avg[t] : 1.0);
+		strcat(timer_string, timer_string_aux);
+
+		// and in the structured report
+		char key[64];
+		snprintf(key, sizeof(key), "phase_%s_min", phases[p].name);
+		report_number(key, phase_min[t]);
+		snprintf(key, sizeof(key), "phase_%s_avg", phases[p].name);
+		report_number(key, phase_avg[t]);
+		snprintf(key, sizeof(key), "phase_%s_max", phases[p].name);
+		report_number(key, phase_max[t]);
+	}
+}
@@ -1,10 +1,11 @@
 // kmeans_mpi.cpp
 // Parallel K-means (MPI) — Bulk Synchronous Parallel (BSP) model
-// File mode: mpiexec -np 4 k_means.exe file <max_iter>
+// File mode: mpiexec -np 4 k_means.exe file <max_iter> [workload]
 // Generate mode: mpiexec -np 4 k_means.exe generate <k> <points_per_proc> <max_iter>
 //
 // Example execution: mpiexec -np 4 phases-parallels/k_means.exe generate 4 1000 50
 // Example execution: mpiexec -np 4 phases-parallels/k_means.exe file 50
+// Example execution: mpiexec -np 4 phases-parallels/k_means.runtime.exe file 50 D
 //
 // Arguments:
 //   argv[1] k               -> number of clusters
@@ -23,10 +24,36 @@
 #include <fstream>
 #include <string>
 #include <cstdio>
+#include <cstdlib>
+#if defined(HYBRID)
+#include <omp.h>
+#include <sched.h>
+#endif
+#include "include/common/common_serial.h"
+#include "include/common/phase_timers.h"
+#if defined(TRACE)
+#include "include/common/trace.h"
+#endif
 
 
 static const int DIM = 2;   // dimension
 
+// timers (TIMER=ON): the total on rank 0, the phases on every rank (min/avg/max in the report)
+#define TIMER_TOTAL 0
+#define TIMER_LOAD 1
+#define TIMER_DISTRIBUTION 2
+#define TIMER_ASSIGN 3
+#define TIMER_REDUCTION 4
+#define TIMER_FINAL 5
+
+const phase_timer phases[] = {
+    {TIMER_LOAD, "load"},
+    {TIMER_DISTRIBUTION, "distribution"},
+    {TIMER_ASSIGN, "assign_accumulate"},
+    {TIMER_REDUCTION, "reduction"},
+    {TIMER_FINAL, "final_sync"}
+};
+
 // Workload definitions (similar to C version)
 
 #if defined(WORKLOAD_A)
@@ -69,6 +96,9 @@ static const int DIM = 2;   // dimension
 #define N_POINTS 5000000
 #define N_MEANS 50000
 #define INTERVAL 50000
+#elif defined(WORKLOAD_RUNTIME)
+// no default workload, it must be given after <max_iter>
+#define WORKLOAD ""
 #else
 #define WORKLOAD_A
 #define WORKLOAD "A"
@@ -77,6 +107,9 @@ static const int DIM = 2;   // dimension
 #define INTERVAL 25
 #endif
 
+// data.<workload>.txt read in file mode (compiled WORKLOAD unless given on the command line)
+std::string workload = WORKLOAD;
+
 double calculate_euclidean_distance(const double* a, const double* b) {
     double dx = a[0] - b[0];
     double dy = a[1] - b[1];
@@ -94,7 +127,7 @@ void read_points_from_file(std::vector<double>& all_points, std::vector<double>&
                           int& total_points, int& k, int world_rank) {
     if (world_rank == 0) {
         char file_name[64];
-        sprintf(file_name, "data.%s.txt", WORKLOAD);
+        snprintf(file_name, sizeof(file_name), "data.%s.txt", workload.c_str());
         
         FILE* file = fopen(file_name, "r");
         if (file == NULL) {
@@ -156,22 +189,32 @@ void read_points_from_file(std::vector<double>& all_points, std::vector<double>&
     MPI_Bcast(&k, 1, MPI_INT, 0, MPI_COMM_WORLD);
     
     if (world_rank != 0) {
-        all_points.resize(total_points * DIM);
         initial_centroids.resize(k * DIM);
     }
-    
-    MPI_Bcast(all_points.data(), total_points * DIM, MPI_DOUBLE, 0, MPI_COMM_WORLD);
     MPI_Bcast(initial_centroids.data(), k * DIM, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+#if !defined(SHARED_MEMORY)
+    // With SHARED_MEMORY the points only go to one window per node (share_points)
+    if (world_rank != 0) {
+        all_points.resize(total_points * DIM);
+    }
+    MPI_Bcast(all_points.data(), total_points * DIM, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#endif
+}
+
+// Block of points of this process: the first (total_points % world_size) processes get one more
+void local_block(int total_points, int world_rank, int world_size, int& start_idx, int& local_count) {
+    int points_per_proc = total_points / world_size;
+    int remainder = total_points % world_size;
+    start_idx = world_rank * points_per_proc + std::min(world_rank, remainder);
+    local_count = points_per_proc + (world_rank < remainder ? 1 : 0);
 }
 
 void distribute_points(const std::vector<double>& all_points, std::vector<double>& local_points,
                       int total_points, int world_rank, int world_size, int& points_per_proc) {
-    points_per_proc = total_points / world_size;
-    int remainder = total_points % world_size;
-    
     // Calculate start and end indices for this process
-    int start_idx = world_rank * points_per_proc + std::min(world_rank, remainder);
-    int local_count = points_per_proc + (world_rank < remainder ? 1 : 0);
+    int start_idx, local_count;
+    local_block(total_points, world_rank, world_size, start_idx, local_count);
     
     local_points.resize(local_count * DIM);
     
@@ -184,6 +227,61 @@ void distribute_points(const std::vector<double>& all_points, std::vector<double
     points_per_proc = local_count; // Update to actual local count
 }
 
+#if defined(SHARED_MEMORY)
+MPI_Comm node_comm = MPI_COMM_NULL;
+MPI_Win node_window = MPI_WIN_NULL;
+
+// One copy of the points per node: the first process of each node allocates a shared window,
+// rank 0 fills its own and broadcasts it to the other nodes' first processes, and every
+// process reads its block in place. Returns the first point of the block
+const double* share_points(std::vector<double>& all_points, int total_points,
+                           int world_rank, int world_size, int& points_per_proc) {
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    int node_rank, node_size;
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+    MPI_Comm leader_comm;
+    MPI_Comm_split(MPI_COMM_WORLD, (node_rank == 0) ? 0 : MPI_UNDEFINED, world_rank, &leader_comm);
+
+    MPI_Aint size = (node_rank == 0) ? (MPI_Aint)total_points * DIM * sizeof(double) : 0;
+    double* base;
+    MPI_Win_allocate_shared(size, sizeof(double), MPI_INFO_NULL, node_comm, &base, &node_window);
+    int displacement_unit;
+    MPI_Win_shared_query(node_window, 0, &size, &displacement_unit, &base);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, node_window);
+
+    if (node_rank == 0) {
+        // rank 0 is also rank 0 of the leaders (ordered by world rank)
+        if (world_rank == 0) {
+            std::copy(all_points.begin(), all_points.end(), base);
+        }
+        MPI_Bcast(base, total_points * DIM, MPI_DOUBLE, 0, leader_comm);
+        MPI_Comm_free(&leader_comm);
+    }
+    std::vector<double>().swap(all_points);
+    MPI_Win_sync(node_window);
+    MPI_Barrier(node_comm);
+    MPI_Win_sync(node_window);
+
+    if (world_rank == 0) {
+        std::cout << "Shared memory: " << node_size << " processes per node, "
+                  << std::fixed << std::setprecision(1) << size / (1024.0 * 1024.0) << " MB of points per node" << std::endl;
+    }
+
+    int start_idx;
+    local_block(total_points, world_rank, world_size, start_idx, points_per_proc);
+    return base + (size_t)start_idx * DIM;
+}
+
+void release_shared_points() {
+    if (node_window != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(node_window);
+        MPI_Win_free(&node_window);
+        MPI_Comm_free(&node_comm);
+    }
+}
+#endif
+
 void initialize_centroids(std::vector<double>& centroids, const std::vector<double>& local_points, 
                          int k, int points_per_proc, int world_rank, int world_size) {
     std::mt19937 rng(1234 + world_rank * 1000);
@@ -223,15 +321,183 @@ void initialize_centroids(std::vector<double>& centroids, const std::vector<doub
     MPI_Bcast(centroids.data(), k*DIM, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 }
 
+// Assign phase: each point goes to its nearest centroid and is added to that centroid's sums.
+// K > 0 fixes the number of centroids at compile time, K == 0 is the generic version using k
+template <int K>
+void assign_points(const double* local_points, const std::vector<double>& centroids,
+                   int k, int points_per_proc, std::vector<int>& local_assign,
+                   std::vector<double>& local_sum, std::vector<int>& local_count) {
+    const int n_centroids = (K > 0) ? K : k;
+#if defined(HYBRID)
+    // The local points are split among the threads, each one accumulating into private sums
+    double* sum = local_sum.data();
+    int* count = local_count.data();
+    #pragma omp parallel for schedule(static) reduction(+: sum[:n_centroids * DIM], count[:n_centroids])
+#endif
+    for (int i = 0; i < points_per_proc; ++i) {
+        double min_dist = std::numeric_limits<double>::max();
+        int min_idx = -1;
+
+        for (int j = 0; j < n_centroids; ++j) {
+            double dist = calculate_euclidean_distance(
+                &local_points[i * DIM], &centroids[j * DIM]);
+            if (dist < min_dist) {
+                min_dist = dist;
+                min_idx = j;
+            }
+        }
+
+        local_assign[i] = min_idx;
+#if defined(HYBRID)
+        sum[min_idx * DIM + 0] += local_points[i * DIM + 0];
+        sum[min_idx * DIM + 1] += local_points[i * DIM + 1];
+        count[min_idx]++;
+#else
+        local_sum[min_idx * DIM + 0] += local_points[i * DIM + 0];
+        local_sum[min_idx * DIM + 1] += local_points[i * DIM + 1];
+        local_count[min_idx]++;
+#endif
+    }
+}
+
+typedef void (*assign_function)(const double*, const std::vector<double>&,
+                                int, int, std::vector<int>&, std::vector<double>&, std::vector<int>&);
+
+// Instances for the k of every workload class (A-H), generic one otherwise or with
+// KMEANS_KERNELS=generic (for the sizes where it is faster)
+assign_function select_assign(int k) {
+    const char* choice = getenv("KMEANS_KERNELS");
+    if (choice != nullptr && strcmp(choice, "generic") == 0) return assign_points<0>;
+    switch (k) {
+        case 2: return assign_points<2>;
+        case 10: return assign_points<10>;
+        case 250: return assign_points<250>;
+        case 1000: return assign_points<1000>;
+        case 2500: return assign_points<2500>;
+        case 5000: return assign_points<5000>;
+        case 10000: return assign_points<10000>;
+        case 50000: return assign_points<50000>;
+        default: return assign_points<0>;
+    }
+}
+
+#if defined(TRACE)
+// Collective: rank 0 records the iteration that just ended, with the points reassigned and the
+// SSE summed over the processes, the slowest process's phase times (the update includes the
+// Allreduce and the convergence check) and the shifts of the centroids
+void trace_iteration(int world_rank, int iteration, const double* points, int points_per_proc,
+                     const std::vector<int>& previous_assign, const std::vector<int>& local_assign,
+                     const std::vector<double>& prev_centroids, const std::vector<double>& centroids, int k,
+                     double start, double assigned, double updated) {
+    double local[2] = {0.0, 0.0}, total[2];
+    for (int i = 0; i < points_per_proc; ++i) {
+        if (local_assign[i] != previous_assign[i]) local[0] += 1.0;
+        local[1] += calculate_euclidean_distance(&points[i * DIM], &centroids[local_assign[i] * DIM]);
+    }
+    double times[3] = {assigned - start, updated - assigned, MPI_Wtime() - updated}, slowest[3];
+    MPI_Reduce(local, total, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(times, slowest, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (world_rank == 0) {
+        trace_record* record = trace_next(iteration);
+        record->reassigned = (int)total[0];
+        record->sse = total[1];
+        record->assign_time = slowest[0];
+        record->update_time = slowest[1];
+        record->other_time = slowest[2];
+        for (int j = 0; j < k; ++j) {
+            trace_save(j, prev_centroids[j * DIM + 0], prev_centroids[j * DIM + 1]);
+            trace_shift(record, j, centroids[j * DIM + 0], centroids[j * DIM + 1]);
+        }
+    }
+}
+#endif
+
+#if defined(ROOFLINE)
+// Collective: the peaks of every thread of every process, probing at the same time on their
+// share of the node's stream arrays, and on rank 0 the counts of the iterations over the slowest
+// process's phases. assign_accumulate computes a distance per point x centroid (5 flops) and adds
+// up every point, reading the points and writing their assignment, reading the centroids and
+// writing the sums of every process; reduction sums the processes' sums, then every process
+// divides the centroids and compares them with the previous ones. The centroids and sums of the
+// processes of a node share its last-level cache, and only reach memory when they do not fit
+void roofline_measure(int world_rank, int world_size, int iterations, int total_points, int k) {
+    MPI_Comm node;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, world_rank, MPI_INFO_NULL, &node);
+    int node_size;
+    MPI_Comm_size(node, &node_size);
+    MPI_Comm_free(&node);
+
+    double local[2] = {0.0, 0.0}, peak[2];
+    MPI_Barrier(MPI_COMM_WORLD);
+#if defined(HYBRID)
+    long length = roofline_stream_length() / (static_cast<long>(node_size) * omp_get_max_threads());
+    double flops = 0.0, bytes = 0.0;
+    #pragma omp parallel reduction(+: flops, bytes)
+    {
+        double thread_flops, thread_bytes;
+        roofline_probe(length, &thread_flops, &thread_bytes);
+        flops += thread_flops;
+        bytes += thread_bytes;
+    }
+    local[0] = flops;
+    local[1] = bytes;
+#else
+    roofline_probe(roofline_stream_length() / node_size, &local[0], &local[1]);
+#endif
+    MPI_Reduce(local, peak, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (world_rank != 0) return;
+    roofline_peak(peak[0], peak[1]);
+
+    double n = total_points, p = world_size;
+    double process_centroid_bytes = static_cast<double>(k) * DIM * sizeof(double);
+    double process_sum_bytes = static_cast<double>(k) * (DIM * sizeof(double) + sizeof(int));
+    double centroid_bytes = roofline_memory_bytes(p * process_centroid_bytes, node_size * process_centroid_bytes);
+    double sum_bytes = roofline_memory_bytes(p * process_sum_bytes, node_size * process_sum_bytes);
+    roofline_phase("assign_accumulate", iterations * (5.0 * n * k + DIM * n),
+                   iterations * (n * (DIM * sizeof(double) + sizeof(int)) + centroid_bytes + sum_bytes),
+                   phase_max[TIMER_ASSIGN]);
+    roofline_phase("reduction", iterations * (p - 1 + 2 * p) * DIM * k,
+                   iterations * sum_bytes, phase_max[TIMER_REDUCTION]);
+}
+#endif
+
+#if defined(HYBRID)
+// Binds each OpenMP thread to its own core among the ones the launcher gave the rank
+// (mpirun --map-by numa --bind-to numa), unless OMP_PROC_BIND leaves it to the OpenMP runtime
+void pin_threads(int world_rank, int world_size) {
+    if (std::getenv("OMP_PROC_BIND") == nullptr) {
+        cpu_set_t rank_set;
+        sched_getaffinity(0, sizeof(cpu_set_t), &rank_set);
+        std::vector<int> cores;
+        for (int c = 0; c < CPU_SETSIZE; ++c) {
+            if (CPU_ISSET(c, &rank_set)) cores.push_back(c);
+        }
+
+        #pragma omp parallel
+        {
+            cpu_set_t thread_set;
+            CPU_ZERO(&thread_set);
+            CPU_SET(cores[omp_get_thread_num() % cores.size()], &thread_set);
+            sched_setaffinity(0, sizeof(cpu_set_t), &thread_set);
+        }
+    }
+
+    if (world_rank == 0) {
+        std::cout << "Hybrid mode: " << world_size << " ranks x " << omp_get_max_threads() << " threads" << std::endl;
+    }
+}
+#endif
+
 void initialize(int argc, char** argv, int world_rank, int world_size,
                 int& k, int& points_per_proc, int& max_iter,
-                std::vector<double>& local_points, std::vector<double>& centroids) {
+                std::vector<double>& local_points, const double*& points, std::vector<double>& centroids) {
     
     // Check number of arguments
     if (argc < 2) {
         if (world_rank == 0) {
             std::cerr << "Usage: " << argv[0] << " <mode> [args...]" << std::endl;
-            std::cerr << "  mode 'file' <max_iter>: Read from data file" << std::endl;
+            std::cerr << "  mode 'file' <max_iter> [workload]: Read from data file" << std::endl;
             std::cerr << "  mode 'generate' <k> <points_per_proc> <max_iter>: Generate data" << std::endl;
         }
         MPI_Finalize();
@@ -250,16 +516,35 @@ void initialize(int argc, char** argv, int world_rank, int world_size,
         }
         
         max_iter = std::stoi(argv[2]);
+        if (argc > 3) {
+            workload = argv[3];
+        }
+        if (workload.empty()) {
+            if (world_rank == 0) {
+                std::cerr << "File mode requires: <max_iter> <workload>" << std::endl;
+            }
+            MPI_Finalize();
+            exit(1);
+        }
         
         // Read data from file
         std::vector<double> all_points;
         std::vector<double> initial_centroids;
         int total_points;
         
+        if(timer_flag){timer_start(TIMER_LOAD);}
         read_points_from_file(all_points, initial_centroids, total_points, k, world_rank);
+        if(timer_flag){timer_stop(TIMER_LOAD);}
         
         // Distribute points among processes
+        if(timer_flag){timer_start(TIMER_DISTRIBUTION);}
+#if defined(SHARED_MEMORY)
+        points = share_points(all_points, total_points, world_rank, world_size, points_per_proc);
+#else
         distribute_points(all_points, local_points, total_points, world_rank, world_size, points_per_proc);
+        points = local_points.data();
+#endif
+        if(timer_flag){timer_stop(TIMER_DISTRIBUTION);}
         
         // Use centroids from file
         centroids = initial_centroids;
@@ -283,11 +568,16 @@ void initialize(int argc, char** argv, int world_rank, int world_size,
         max_iter = std::stoi(argv[4]);
         
         // Generate fixed points for each process
+        if(timer_flag){timer_start(TIMER_LOAD);}
         generate_local_points(local_points, points_per_proc, world_rank);
+        points = local_points.data();
+        if(timer_flag){timer_stop(TIMER_LOAD);}
         
         // Initialize Centroids
+        if(timer_flag){timer_start(TIMER_DISTRIBUTION);}
         centroids.resize(k * DIM, 0.0);
         initialize_centroids(centroids, local_points, k, points_per_proc, world_rank, world_size);
+        if(timer_flag){timer_stop(TIMER_DISTRIBUTION);}
         
     } else {
         if (world_rank == 0) {
@@ -300,18 +590,31 @@ void initialize(int argc, char** argv, int world_rank, int world_size,
 
 
 int main(int argc, char** argv) {
+#if defined(HYBRID)
+    // Only the master thread calls MPI
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#else
     MPI_Init(&argc, &argv);
+#endif
 
     int world_rank, world_size;
     MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
     MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+#if defined(HYBRID)
+    pin_threads(world_rank, world_size);
+#endif
+    setup_common();
+    timer_name(TIMER_TOTAL, "total");
+    timer_start(TIMER_TOTAL);
 
     int k, points_per_proc, max_iter;
     std::vector<double> local_points;
+    const double* points; // local_points, or the block of the node-shared points
     std::vector<double> centroids;
 
     // Initialize data and parameters
-    initialize(argc, argv, world_rank, world_size, k, points_per_proc, max_iter, local_points, centroids);
+    initialize(argc, argv, world_rank, world_size, k, points_per_proc, max_iter, local_points, points, centroids);
     
     MPI_Barrier(MPI_COMM_WORLD);
 
@@ -319,6 +622,7 @@ int main(int argc, char** argv) {
     std::vector<int> local_assign(points_per_proc, -1);
     std::vector<double> local_sum(k * DIM, 0.0); // Sum of coordinates for each cluster
     std::vector<int> local_count(k, 0); // Count how many points each process has assigned to each cluster locally
+    assign_function assign = select_assign(k);
 
     // Global (for rank 0)
     std::vector<double> global_sum(k * DIM, 0.0);
@@ -329,6 +633,9 @@ int main(int argc, char** argv) {
     const double convergence_threshold = 1e-6; // max change less than 0.000001 units
     bool converged = false;
     int iterations_completed = 0;
+#if defined(TRACE)
+    if (world_rank == 0) trace_setup(k);
+#endif
 
     // Max iterations control
     for (int iter = 0; iter < max_iter && !converged; ++iter) {
@@ -342,30 +649,23 @@ int main(int argc, char** argv) {
         // ------------------------
 
         // Each process assigns points to the nearest centroid
-        for (int i = 0; i < points_per_proc; ++i) {
-            double min_dist = std::numeric_limits<double>::max();
-            int min_idx = -1;
-
-            for (int j = 0; j < k; ++j) {
-                double dist = calculate_euclidean_distance(
-                    &local_points[i * DIM], &centroids[j * DIM]);
-                if (dist < min_dist) {
-                    min_dist = dist;
-                    min_idx = j;
-                }
-            }
-
-            local_assign[i] = min_idx;
-            local_sum[min_idx * DIM + 0] += local_points[i * DIM + 0];
-            local_sum[min_idx * DIM + 1] += local_points[i * DIM + 1];
-            local_count[min_idx]++;
-        }
+#if defined(TRACE)
+        double trace_start = MPI_Wtime();
+        std::vector<int> trace_assign(local_assign);
+#endif
+        if(timer_flag){timer_start(TIMER_ASSIGN);}
+        assign(points, centroids, k, points_per_proc, local_assign, local_sum, local_count);
+        if(timer_flag){timer_stop(TIMER_ASSIGN);}
+#if defined(TRACE)
+        double trace_assigned = MPI_Wtime();
+#endif
 
         // ------------------------
         // Synchronize Phase (All-to-All Broadcast)
         // ------------------------
 
         // All processes exchange their local sums and counts with each other using Allreduce
+        if(timer_flag){timer_start(TIMER_REDUCTION);}
         MPI_Allreduce(local_sum.data(), global_sum.data(), k*DIM, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
         MPI_Allreduce(local_count.data(), global_count.data(), k, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
 
@@ -391,6 +691,11 @@ int main(int argc, char** argv) {
             max_change = std::max(max_change, change);
         }
         
+        if(timer_flag){timer_stop(TIMER_REDUCTION);}
+#if defined(TRACE)
+        double trace_updated = MPI_Wtime();
+#endif
+
         if (max_change < convergence_threshold) {
             converged = true;
             if (world_rank == 0) {
@@ -410,10 +715,34 @@ int main(int argc, char** argv) {
             }
             std::cout << std::endl;
         }
+#if defined(TRACE)
+        trace_iteration(world_rank, iter + 1, points, points_per_proc, trace_assign, local_assign,
+                        prev_centroids, centroids, k, trace_start, trace_assigned, trace_updated);
+#endif
     }
 
     
+    if(timer_flag){timer_start(TIMER_FINAL);}
     MPI_Barrier(MPI_COMM_WORLD);
+    if(timer_flag){timer_stop(TIMER_FINAL);}
+    timer_stop(TIMER_TOTAL);
+    phase_timers_reduce(phases, sizeof(phases) / sizeof(phases[0]), 0);
+    int total_points = 0;
+    MPI_Reduce(&points_per_proc, &total_points, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+#if defined(ROOFLINE)
+    // after the run, so the probe does not disturb it
+    roofline_measure(world_rank, world_size, iterations_completed, total_points, k);
+#endif
+#if defined(TRACE)
+    if (world_rank == 0) {
+#if defined(HYBRID)
+        trace_write(workload.c_str(), "phases-parallels", total_points, k, world_size, omp_get_max_threads());
+#else
+        trace_write(workload.c_str(), "phases-parallels", total_points, k, world_size, 1);
+#endif
+        trace_release();
+    }
+#endif
     if (world_rank == 0) {
         std::cout << "\n-------- Final Results --------" << std::endl;
         if (converged) {
@@ -428,8 +757,30 @@ int main(int argc, char** argv) {
                       << centroids[j * DIM + 0] << ", "
                       << centroids[j * DIM + 1] << ")" << std::endl;
         }
+
+        // there is no reference solution here: the verification is not performed, and whether
+        // the centroids converged is reported on its own
+        snprintf(checksum_string, sizeof(checksum_string), "                    %s after %d iterations",
+                 converged ? "converged" : "not converged", iterations_completed);
+        phase_timers_append(phases, sizeof(phases) / sizeof(phases[0]));
+        std::cout << std::flush;
+        // fields of the structured report (KMEANS_REPORT_FILE)
+        report_integer("n_points", total_points);
+        report_integer("n_means", k);
+        report_integer("ranks", world_size);
+#if defined(HYBRID)
+        report_integer("threads", omp_get_max_threads());
+#else
+        report_integer("threads", 1);
+#endif
+        report_integer("iterations", iterations_completed);
+        report_text("convergence", converged ? "converged" : "not converged");
+        execution_report((char*)"K-Means", (char*)workload.c_str(), timer_read(TIMER_TOTAL), VERIFICATION_NOT_PERFORMED);
     }
 
+#if defined(SHARED_MEMORY)
+    release_shared_points();
+#endif
     MPI_Finalize();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "include/k-means/k_means.h"
+
+// converts the binary dump of a DEBUG=ON run (kmeans.debug.bin) into the text report
+// (kmeans.debug.dat), comparing it with the reference values of the data set
+// usage: ./debug_converter.<WORKLOAD>.exe [dump file] [report file]
+int main(int argc, char* argv[]){
+    char* dump_name = (argc > 1) ? argv[1] : (char*)DEBUG_DUMP_FILE;
+    char* report_name = (argc > 2) ? argv[2] : (char*)DEBUG_REPORT_FILE;
+
+    points = (point*) malloc(N_POINTS * sizeof(point));
+    means = (mean*) malloc(N_MEANS * sizeof(mean));
+    points_cluster_verification = (int*) malloc(N_POINTS * sizeof(int));
+    means_verification = (mean*) malloc(N_MEANS * sizeof(mean));
+
+    // reference values
+    initialization();
+
+    FILE* file = fopen(dump_name, "rb");
+    if(file == NULL){
+        printf("Error when trying to open %s!\n", dump_name);
+        exit(-1);
+    }
+
+    debug_header header;
+    if(fread(&header, sizeof(debug_header), 1, file) != 1){exit(-1);}
+    if(memcmp(header.magic, DEBUG_MAGIC, 4) != 0 || header.n_points != N_POINTS || header.n_means != N_MEANS){
+        printf("Error: %s does not match workload %s!\n", dump_name, (char*)WORKLOAD);
+        exit(-1);
+    }
+    iteration_control = header.iterations;
+
+    int* values = (int*) malloc(N_POINTS * sizeof(int));
+    if(fread(values, sizeof(int), N_POINTS, file) != (size_t)N_POINTS){exit(-1);}
+    for(int i = 0; i < N_POINTS; i++){
+        points[i].cluster = values[i];
+    }
+
+    double* coordinates = (double*) malloc(2 * N_MEANS * sizeof(double));
+    if(fread(coordinates, sizeof(double), 2 * N_MEANS, file) != (size_t)(2 * N_MEANS)){exit(-1);}
+    if(fread(values, sizeof(int), N_MEANS, file) != (size_t)N_MEANS){exit(-1);}
+    for(int i = 0; i < N_MEANS; i++){
+        means[i].x = coordinates[i];
+        means[i].y = coordinates[N_MEANS + i];
+        means[i].count = values[i];
+    }
+    free(coordinates);
+    free(values);
+    fclose(file);
+
+    verification();
+    write_debug_report(report_name);
+    printf("%s written (verification %s)\n", report_name, passed_verification ? "PASSED" : "FAILED");
+
+    release_resources();
+    return 0;
+}
@@ -0,0 +1,131 @@
+// per-iteration trace (TRACE=ON): one record per k-means iteration, kept in memory and written
+// once at the end of the run to kmeans.trace.bin (or KMEANS_TRACE_FILE) by the root, so the
+// iterations themselves only pay for the statistics; trace_converter turns the file into a
+// text table or a CSV file
+// layout: trace_header, then n_records trace_record
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_MAGIC "KMT1"
+#define TRACE_FILE "kmeans.trace.bin"
+#define TRACE_REPORT_FILE "kmeans.trace.dat"
+
+typedef struct{
+	char magic[4];
+	char workload[8];
+	char variant[24];
+	int n_points;
+	int n_means;
+	int ranks;
+	int threads;
+	int n_records;
+} trace_header;
+
+typedef struct{
+	int iteration;
+	// points whose cluster changed in the assignment
+	int reassigned;
+	// distance moved by the means in the update
+	double max_shift;
+	double mean_shift;
+	// sum of the squared distances of the points to their updated means
+	double sse;
+	// fraction of the point x mean distances the assignment skipped (0 for the
+	// brute-force kernels, which compute all of them)
+	double pruned;
+	// seconds of the iteration's phases (the slowest rank's in the MPI variants):
+	// assignment, update of the means (with its communication) and the rest
+	double assign_time;
+	double update_time;
+	double other_time;
+} trace_record;
+
+trace_record* trace_records;
+int trace_n_records;
+int trace_capacity;
+int trace_n_means;
+// means before the update, for the shifts
+double* trace_previous_x;
+double* trace_previous_y;
+
+void trace_setup(int n_means){
+	trace_n_records = 0;
+	trace_capacity = 64;
+	trace_records = (trace_record*) malloc(trace_capacity * sizeof(trace_record));
+	trace_n_means = n_means;
+	trace_previous_x = (double*) malloc(n_means * sizeof(double));
+	trace_previous_y = (double*) malloc(n_means * sizeof(double));
+	if(trace_records == NULL || trace_previous_x == NULL || trace_previous_y == NULL){
+		printf("Error when trying to allocate the trace!\n");
+		exit(-1);
+	}
+}
+
+// new record of the iteration, zeroed
+trace_record* trace_next(int iteration){
+	if(trace_n_records == trace_capacity){
+		trace_capacity *= 2;
+		trace_records = (trace_record*) realloc(trace_records, trace_capacity * sizeof(trace_record));
+		if(trace_records == NULL){
+			printf("Error when trying to allocate the trace!\n");
+			exit(-1);
+		}
+	}
+	trace_record* record = &trace_records[trace_n_records++];
+	memset(record, 0, sizeof(trace_record));
+	record->iteration = iteration;
+	return record;
+}
+
+// position of mean i before the update
+void trace_save(int i, double x, double y){
+	trace_previous_x[i] = x;
+	trace_previous_y[i] = y;
+}
+
+// adds the move of mean i to its updated position (x, y) to the record's shifts
+void trace_shift(trace_record* record, int i, double x, double y){
+	double dx = x - trace_previous_x[i];
+	double dy = y - trace_previous_y[i];
+	double shift = sqrt(dx * dx + dy * dy);
+	if(shift > record->max_shift){
+		record->max_shift = shift;
+	}
+	record->mean_shift += shift / trace_n_means;
+}
+
+void trace_write(const char* workload, const char* variant, int n_points, int n_means, int ranks, int threads){
+	char* file_name = getenv("KMEANS_TRACE_FILE");
+	if(file_name == NULL || file_name[0] == '\0'){
+		file_name = (char*)TRACE_FILE;
+	}
+	FILE* file = fopen(file_name, "wb");
+	if(file == NULL){
+		printf("Error when trying to open %s!\n", file_name);
+		return;
+	}
+	trace_header header;
+	memset(&header, 0, sizeof(trace_header));
+	memcpy(header.magic, TRACE_MAGIC, 4);
+	snprintf(header.workload, sizeof(header.workload), "%s", workload);
+	snprintf(header.variant, sizeof(header.variant), "%s", variant);
+	header.n_points = n_points;
+	header.n_means = n_means;
+	header.ranks = ranks;
+	header.threads = threads;
+	header.n_records = trace_n_records;
+	fwrite(&header, sizeof(trace_header), 1, file);
+	fwrite(trace_records, sizeof(trace_record), trace_n_records, file);
+	fclose(file);
+	printf(" Trace: %d iterations in %s\n", trace_n_records, file_name);
+}
+
+void trace_release(){
+	free(trace_records);
+	free(trace_previous_x);
+	free(trace_previous_y);
+	trace_records = NULL;
+	trace_n_records = 0;
+}
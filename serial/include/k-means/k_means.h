@@ -1,4 +1,10 @@
 #include "../common/common_serial.h"
+#include "../common/arena.h"
+#if defined(TRACE)
+#include "../common/trace.h"
+#endif
+#include <stdint.h>
+#include <pthread.h>
 
 #if defined(WORKLOAD_A)
 #define WORKLOAD "A"
@@ -40,6 +46,16 @@
 #define N_POINTS 5000000
 #define N_MEANS 50000
 #define INTERVAL 50000
+#elif defined(WORKLOAD_RUNTIME)
+// workload given on the command line, sizes read from the data set header
+// (INTERVAL is the largest one among the classes, it only sizes the COMPACT coordinates)
+#define WORKLOAD workload_name
+#define N_POINTS n_points
+#define N_MEANS n_means
+#define INTERVAL 50000
+char workload_name[8];
+int n_points;
+int n_means;
 #else
 #define WORKLOAD_A
 #define WORKLOAD "A"
@@ -48,6 +64,35 @@
 #define INTERVAL 25
 #endif
 
+// every workload class (same values as above), used to select workloads at run time
+typedef struct{
+	const char* name;
+	int n_points;
+	int n_means;
+	int interval;
+} workload_class;
+
+const workload_class workload_classes[] = {
+	{"A", 10, 2, 25},
+	{"B", 1000, 10, 50},
+	{"C", 10000, 250, 100},
+	{"D", 100000, 1000, 200},
+	{"E", 250000, 2500, 1000},
+	{"F", 500000, 5000, 5000},
+	{"G", 1000000, 10000, 25000},
+	{"H", 5000000, 50000, 50000}
+};
+#define N_WORKLOAD_CLASSES ((int)(sizeof(workload_classes) / sizeof(workload_classes[0])))
+
+const workload_class* find_workload_class(const char* name){
+	for(int i = 0; i < N_WORKLOAD_CLASSES; i++){
+		if(strcmp(workload_classes[i].name, name) == 0){
+			return &workload_classes[i];
+		}
+	}
+	return NULL;
+}
+
 // relative tolerance for floating-point comparison
 #define RELATIVE_TOLERANCE 1e-10  
 // relative tolerance: allows small rounding differences in floating-point operations
@@ -66,11 +111,72 @@
 #define TIMER_MEMORY_TRANSFERS 2
 #define TIMER_COMPUTATION 3
 
+// coordinate storage
+// the data generator only produces integer coordinates in [0, INTERVAL), so with COMPACT=ON
+// the points are kept as unsigned integers (in memory and in the binary data set) and widened
+// to double inside the kernels; the means are always fractional and stay in double precision
+#if defined(COMPACT)
+#if INTERVAL <= 65536
+typedef uint16_t coord_t;
+#else
+typedef uint32_t coord_t;
+#endif
+#else
+typedef double coord_t;
+#endif
+
+// binary data set (data.<WORKLOAD>.bin)
+// layout after the header: points x[n_points], points y[n_points] (coord_bytes each, 2 or 4 for
+// unsigned integers and 8 for double), initial means x[n_means], y[n_means] (double), reference
+// clusters[n_points] (int), reference means x[n_means], y[n_means] (double), count[n_means] (int)
+// the initial cluster of every point and the initial count of every mean are zero
+#define DATASET_MAGIC "KMB1"
+
+typedef struct{
+	char magic[4];
+	int n_points;
+	int n_means;
+	int coord_bytes;
+	int iterations;
+} dataset_header;
+
+// digests of the reference solution (data.<WORKLOAD>.digest)
+// layout after the header: one hash per block of block_points cluster assignments, then one
+// hash per block of block_means cluster counts (uint64_t, FNV-1a over the int values)
+#define DIGEST_MAGIC "KMD1"
+#define DIGEST_BLOCK_POINTS 65536
+#define DIGEST_BLOCK_MEANS 1024
+#define DIGEST_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define DIGEST_PRIME 0x100000001b3ULL
+
+typedef struct{
+	char magic[4];
+	int n_points;
+	int n_means;
+	int block_points;
+	int block_means;
+} digest_header;
+
+// binary debug dump (kmeans.debug.bin), written by a background thread when DEBUG=ON
+// layout after the header: clusters[n_points] (int), means x[n_means], y[n_means] (double),
+// count[n_means] (int); debug_converter turns it into the kmeans.debug.dat text report
+#define DEBUG_MAGIC "KMG1"
+#define DEBUG_DUMP_FILE "kmeans.debug.bin"
+#define DEBUG_REPORT_FILE "kmeans.debug.dat"
+
+typedef struct{
+	char magic[4];
+	char workload[4];
+	int n_points;
+	int n_means;
+	int iterations;
+} debug_header;
+
 // structs
 typedef struct{
 	int cluster;
-	double x;
-	double y;
+	coord_t x;
+	coord_t y;
 } point;
 
 typedef struct{
@@ -82,30 +188,238 @@ typedef struct{
 // global variables
 int iteration_control;
 int modified;
+// points that changed cluster in the last find_clusters()
+int reassigned;
 point* points;
 mean* means;
 int* points_cluster_verification;
 mean* means_verification;
 int passed_verification;
+pthread_t debug_thread;
+int debug_thread_started;
+#if defined(THREADS)
+// sums of each worker of the work-stealing engine, N_MEANS per worker
+mean* worker_sums;
+// read-only copy of the means per socket, refreshed before every assignment
+mean** means_replicas;
+#endif
+#if defined(ROOFLINE)
+// flops of a point x mean distance: two differences, two squares and their sum
+#define DISTANCE_FLOPS 5
+#if defined(THREADS)
+// peaks each worker measured
+double* roofline_worker_flops;
+double* roofline_worker_bytes;
+#endif
+#endif
+#if defined(HASH_VERIFICATION)
+// the reference clusters are only read when the digests do not match
+char reference_file_name[64];
+long reference_clusters_offset;
+int reference_clusters_binary;
+#endif
 
 // k-means
 void k_means();
 void find_clusters();
 void calculate_means();
+#if defined(TRACE)
+double trace_iteration(double start, double assigned, double updated);
+#endif
+#if defined(WORKLOAD_RUNTIME)
+void select_kernels();
+#endif
+#if defined(THREADS)
+void first_touch_task(int worker);
+#endif
+#if defined(ARENA)
+size_t arena_bytes();
+#endif
+#if defined(ROOFLINE)
+void roofline_measure();
+#if defined(THREADS)
+void roofline_task(int worker);
+#endif
+#endif
 
 // other function prototypes
 void initialization();
 void verification();
 void debug_results();
+void debug_results_wait();
+void write_debug_report(const char* file_name);
 void release_resources();
 
+uint64_t digest_add(uint64_t hash, int value){
+	uint32_t bytes = (uint32_t)value;
+	for(int b = 0; b < 4; b++){
+		hash ^= (bytes >> (8 * b)) & 0xff;
+		hash *= DIGEST_PRIME;
+	}
+	return hash;
+}
+
+uint64_t digest_clusters(int begin, int end){
+	uint64_t hash = DIGEST_OFFSET_BASIS;
+	for(int i = begin; i < end; i++){
+		hash = digest_add(hash, points[i].cluster);
+	}
+	return hash;
+}
+
+uint64_t digest_counts(int begin, int end){
+	uint64_t hash = DIGEST_OFFSET_BASIS;
+	for(int i = begin; i < end; i++){
+		hash = digest_add(hash, means[i].count);
+	}
+	return hash;
+}
+
+#if defined(WORKLOAD_RUNTIME)
+// the workload is the first argument (or KMEANS_WORKLOAD); N_POINTS and N_MEANS come from the
+// binary data set header or, for the text data set, from the counts before each section
+void select_workload(int argc, char* argv[]){
+	char* name = (argc > 1) ? argv[1] : getenv("KMEANS_WORKLOAD");
+	if(name == NULL){
+		printf("Usage: %s <workload>\n", argv[0]);
+		exit(-1);
+	}
+	snprintf(workload_name, sizeof(workload_name), "%s", name);
+
+	char file_name[64];
+	sprintf(file_name, "data.%s.bin", workload_name);
+
+	FILE* file = fopen(file_name, "rb");
+	if(file != NULL){
+		dataset_header header;
+		if(fread(&header, sizeof(dataset_header), 1, file) != 1 || memcmp(header.magic, DATASET_MAGIC, 4) != 0){
+			printf("Error: %s is not a data set!\n", file_name);
+			exit(-1);
+		}
+		n_points = header.n_points;
+		n_means = header.n_means;
+		fclose(file);
+		return;
+	}
+
+	sprintf(file_name, "data.%s.txt", workload_name);
+	file = fopen(file_name, "r");
+	if(file == NULL){
+		printf("Error when trying to open the data set!\n");
+		exit(-1);
+	}
+	if(fscanf(file, "%d", &n_points) != 1){exit(-1);}
+	// rest of the first line, blank line, then one line per point
+	char line[256];
+	for(int i = 0; i < n_points + 2; i++){
+		if(fgets(line, sizeof(line), file) == NULL){exit(-1);}
+	}
+	if(fscanf(file, "%d", &n_means) != 1){exit(-1);}
+	fclose(file);
+}
+#endif
+
+// reads n coordinates stored with coord_bytes bytes each (2 and 4: unsigned integers, 8: double)
+void read_coordinates(FILE* file, coord_t* coords, int n, int coord_bytes){
+	// same width means same type, read in place
+	if(coord_bytes == (int)sizeof(coord_t)){
+		if(fread(coords, sizeof(coord_t), n, file) != (size_t)n){exit(-1);}
+		return;
+	}
+	void* stored = malloc((size_t)n * coord_bytes);
+	if(fread(stored, coord_bytes, n, file) != (size_t)n){exit(-1);}
+	for(int i = 0; i < n; i++){
+		if(coord_bytes == 2){coords[i] = ((uint16_t*)stored)[i];}
+		else if(coord_bytes == 4){coords[i] = ((uint32_t*)stored)[i];}
+		else{coords[i] = ((double*)stored)[i];}
+	}
+	free(stored);
+}
+
+void read_binary_dataset(FILE* file, char* file_name){
+	dataset_header header;
+	if(fread(&header, sizeof(dataset_header), 1, file) != 1){exit(-1);}
+	if(memcmp(header.magic, DATASET_MAGIC, 4) != 0 || header.n_points != N_POINTS || header.n_means != N_MEANS){
+		printf("Error: %s does not match workload %s!\n", file_name, (char*)WORKLOAD);
+		exit(-1);
+	}
+	if(header.coord_bytes != 2 && header.coord_bytes != 4 && header.coord_bytes != 8){
+		printf("Error: %s stores %d-byte coordinates!\n", file_name, header.coord_bytes);
+		exit(-1);
+	}
+
+	// points (the file keeps x and y as separate arrays)
+	coord_t* coords = (coord_t*) malloc(N_POINTS * sizeof(coord_t));
+	read_coordinates(file, coords, N_POINTS, header.coord_bytes);
+	for(int i = 0; i < N_POINTS; i++){
+		points[i].x = coords[i];
+		points[i].cluster = 0;
+	}
+	read_coordinates(file, coords, N_POINTS, header.coord_bytes);
+	for(int i = 0; i < N_POINTS; i++){
+		points[i].y = coords[i];
+	}
+	free(coords);
+
+	// initial means
+	double* values = (double*) malloc(N_MEANS * sizeof(double));
+	if(fread(values, sizeof(double), N_MEANS, file) != (size_t)N_MEANS){exit(-1);}
+	for(int i = 0; i < N_MEANS; i++){
+		means[i].x = values[i];
+		means[i].count = 0;
+	}
+	if(fread(values, sizeof(double), N_MEANS, file) != (size_t)N_MEANS){exit(-1);}
+	for(int i = 0; i < N_MEANS; i++){
+		means[i].y = values[i];
+	}
+
+	// verification values
+#if defined(HASH_VERIFICATION)
+	strcpy(reference_file_name, file_name);
+	reference_clusters_offset = ftell(file);
+	reference_clusters_binary = 1;
+	if(fseek(file, N_POINTS * sizeof(int), SEEK_CUR) != 0){exit(-1);}
+#else
+	if(fread(points_cluster_verification, sizeof(int), N_POINTS, file) != (size_t)N_POINTS){exit(-1);}
+#endif
+	if(fread(values, sizeof(double), N_MEANS, file) != (size_t)N_MEANS){exit(-1);}
+	for(int i = 0; i < N_MEANS; i++){
+		means_verification[i].x = values[i];
+	}
+	if(fread(values, sizeof(double), N_MEANS, file) != (size_t)N_MEANS){exit(-1);}
+	for(int i = 0; i < N_MEANS; i++){
+		means_verification[i].y = values[i];
+	}
+	free(values);
+	int* counts = (int*) malloc(N_MEANS * sizeof(int));
+	if(fread(counts, sizeof(int), N_MEANS, file) != (size_t)N_MEANS){exit(-1);}
+	for(int i = 0; i < N_MEANS; i++){
+		means_verification[i].count = counts[i];
+	}
+	free(counts);
+
+	iteration_control = header.iterations;
+}
+
+// the binary data set (data.<WORKLOAD>.bin) is used when present, otherwise the text one
 void initialization(){
 	// setup common stuff
 	setup_common();
-
-    FILE* file;
+	timer_name(TIMER_TOTAL, "total");
+	timer_name(TIMER_LINEARIZATION, "linearization");
+	timer_name(TIMER_MEMORY_TRANSFERS, "memory_transfers");
+	timer_name(TIMER_COMPUTATION, "computation");
 
 	char file_name[64];
+	sprintf(file_name, "data.%s.bin", (char*)WORKLOAD);
+
+	FILE* file = fopen(file_name, "rb");
+	if(file != NULL){
+		read_binary_dataset(file, file_name);
+		fclose(file);
+		return;
+	}
+
 	sprintf(file_name, "data.%s.txt", (char*)WORKLOAD);
 
 	file = fopen(file_name, "r");
@@ -114,14 +428,17 @@ void initialization(){
         printf("Error when trying to open the data set!\n");
         exit(-1);
     }
-    else{	
+    else{
+	    double value;
 	    // read N_POINTS
         int temp_n_points;
 	    if(!fscanf(file, "%d", &temp_n_points)){exit(-1);}
         // read points
         for(int i = 0; i < N_POINTS; i++){
-		    if(!fscanf(file, "%la", &points[i].x)){exit(-1);}
-            if(!fscanf(file, "%la", &points[i].y)){exit(-1);}
+		    if(!fscanf(file, "%la", &value)){exit(-1);}
+		    points[i].x = value;
+            if(!fscanf(file, "%la", &value)){exit(-1);}
+            points[i].y = value;
 			if(!fscanf(file, "%d", &points[i].cluster)){exit(-1);}
 	    }
 
@@ -137,10 +454,20 @@ void initialization(){
 
 		// read N_POINTS (verification values)
 	    if(!fscanf(file, "%d", &temp_n_points)){exit(-1);}
+#if defined(HASH_VERIFICATION)
+        // skip the reference clusters, remembering where they start
+        strcpy(reference_file_name, file_name);
+        reference_clusters_offset = ftell(file);
+        reference_clusters_binary = 0;
+        for(int i = 0; i < N_POINTS; i++){
+			if(fscanf(file, "%*d") == EOF){exit(-1);}
+	    }
+#else
         // read points
         for(int i = 0; i < N_POINTS; i++){
 			if(!fscanf(file, "%d", &points_cluster_verification[i])){exit(-1);}
 	    }
+#endif
 
 		// read N_MEANS (verification values)
 	    if(!fscanf(file, "%d", &temp_n_means)){exit(-1);}
@@ -149,7 +476,7 @@ void initialization(){
 		    if(!fscanf(file, "%la", &means_verification[i].x)){exit(-1);}
             if(!fscanf(file, "%la", &means_verification[i].y)){exit(-1);}
 			if(!fscanf(file, "%d", &means_verification[i].count)){exit(-1);}
-	    }		
+	    }
 
         // read iteration_control
         if(!fscanf(file, "%d\n", &iteration_control)){exit(-1);}
@@ -158,6 +485,92 @@ void initialization(){
     fclose(file);
 }
 
+#if defined(HASH_VERIFICATION)
+void load_reference_clusters(){
+	if(points_cluster_verification != NULL){
+		return;
+	}
+	points_cluster_verification = (int*) malloc(N_POINTS * sizeof(int));
+
+	FILE* file = fopen(reference_file_name, reference_clusters_binary ? "rb" : "r");
+	if(file == NULL || fseek(file, reference_clusters_offset, SEEK_SET) != 0){
+		printf("Error when trying to read the reference clusters!\n");
+		exit(-1);
+	}
+	if(reference_clusters_binary){
+		if(fread(points_cluster_verification, sizeof(int), N_POINTS, file) != (size_t)N_POINTS){exit(-1);}
+	}
+	else{
+		for(int i = 0; i < N_POINTS; i++){
+			if(!fscanf(file, "%d", &points_cluster_verification[i])){exit(-1);}
+		}
+	}
+	fclose(file);
+}
+
+// compares the clusters and the counts with the digests, block by block; the reference
+// clusters are loaded to count the correct points only when some block does not match
+int hash_verification(){
+	char file_name[64];
+	sprintf(file_name, "data.%s.digest", (char*)WORKLOAD);
+
+	FILE* file = fopen(file_name, "rb");
+	if(file == NULL){
+		printf("Error when trying to open the digests (run the data generator again)!\n");
+		exit(-1);
+	}
+
+	digest_header header;
+	if(fread(&header, sizeof(digest_header), 1, file) != 1){exit(-1);}
+	if(memcmp(header.magic, DIGEST_MAGIC, 4) != 0 || header.n_points != N_POINTS || header.n_means != N_MEANS){
+		printf("Error: %s does not match workload %s!\n", file_name, (char*)WORKLOAD);
+		exit(-1);
+	}
+
+	int point_blocks = (N_POINTS + header.block_points - 1) / header.block_points;
+	int mean_blocks = (N_MEANS + header.block_means - 1) / header.block_means;
+	uint64_t* hashes = (uint64_t*) malloc((point_blocks + mean_blocks) * sizeof(uint64_t));
+	if(fread(hashes, sizeof(uint64_t), point_blocks + mean_blocks, file) != (size_t)(point_blocks + mean_blocks)){exit(-1);}
+	fclose(file);
+
+	int mismatched_points = 0;
+	int mismatched_means = 0;
+
+	#pragma omp parallel for schedule(dynamic, 1) reduction(+:mismatched_points)
+	for(int b = 0; b < point_blocks; b++){
+		int end = (b + 1) * header.block_points < N_POINTS ? (b + 1) * header.block_points : N_POINTS;
+		if(digest_clusters(b * header.block_points, end) != hashes[b]){
+			mismatched_points++;
+		}
+	}
+	for(int b = 0; b < mean_blocks; b++){
+		int end = (b + 1) * header.block_means < N_MEANS ? (b + 1) * header.block_means : N_MEANS;
+		if(digest_counts(b * header.block_means, end) != hashes[point_blocks + b]){
+			mismatched_means++;
+		}
+	}
+	free(hashes);
+
+	if(mismatched_means > 0){
+		passed_verification = 0;
+	}
+	if(mismatched_points == 0){
+		return N_POINTS;
+	}
+
+	// diagnose the mismatch against the full reference
+	passed_verification = 0;
+	load_reference_clusters();
+	int correct_points = 0;
+	for(int i = 0; i < N_POINTS; i++){
+		if(points[i].cluster == points_cluster_verification[i]){
+			correct_points++;
+		}
+	}
+	return correct_points;
+}
+#endif
+
 int passed_auxiliary_verification(double result, double result_reference_value){
     // flexible correctness check
     // absolute difference between a calculated and a reference value
@@ -183,6 +596,9 @@ void verification(){
 	int correct_means = 0;
 
 	// verification for each point
+#if defined(HASH_VERIFICATION)
+	correct_points = hash_verification();
+#else
 	for(int i = 0; i < N_POINTS; i++){
 		if(points[i].cluster == points_cluster_verification[i]){
             correct_points++;
@@ -191,6 +607,7 @@ void verification(){
 			passed_verification = 0;
 		}
 	}
+#endif
 
 	// verification for each mean
 	for(int i = 0; i < N_MEANS; i++){
@@ -235,75 +652,137 @@ void verification(){
 	strcat(timer_string, timer_string_aux);
 }
 
+// background writer: dumps the assignments and the means without formatting them
+void* debug_results_writer(void* argument){
+    FILE* file = fopen(DEBUG_DUMP_FILE, "wb");
+    if(!file){
+        printf("Erro ao abrir arquivo de debug!\n");
+        return NULL;
+    }
+
+    debug_header header;
+    memset(&header, 0, sizeof(debug_header));
+    memcpy(header.magic, DEBUG_MAGIC, 4);
+    for(int c = 0; c < 3 && ((char*)WORKLOAD)[c] != '\0'; c++){
+        header.workload[c] = ((char*)WORKLOAD)[c];
+    }
+    header.n_points = N_POINTS;
+    header.n_means = N_MEANS;
+    header.iterations = iteration_control;
+    fwrite(&header, sizeof(debug_header), 1, file);
+
+    int* values = (int*) malloc(N_POINTS * sizeof(int));
+    for(int i = 0; i < N_POINTS; i++){values[i] = points[i].cluster;}
+    fwrite(values, sizeof(int), N_POINTS, file);
+    free(values);
+    double* coordinates = (double*) malloc(2 * N_MEANS * sizeof(double));
+    int* counts = (int*) malloc(N_MEANS * sizeof(int));
+    for(int i = 0; i < N_MEANS; i++){
+        coordinates[i] = means[i].x;
+        coordinates[N_MEANS + i] = means[i].y;
+        counts[i] = means[i].count;
+    }
+    fwrite(coordinates, sizeof(double), 2 * N_MEANS, file);
+    fwrite(counts, sizeof(int), N_MEANS, file);
+    free(coordinates);
+    free(counts);
+
+    fclose(file);
+    return NULL;
+}
+
+// the dump runs while the report is printed; release_resources() waits for it
 void debug_results(){
     if(debug_flag){
-        FILE* file = fopen("kmeans.debug.dat", "w");
-        if (!file) { 
-            printf("Erro ao abrir arquivo de debug!\n");
-            return; 
+        if(pthread_create(&debug_thread, NULL, debug_results_writer, NULL) == 0){
+            debug_thread_started = 1;
         }
+        else{
+            debug_results_writer(NULL);
+        }
+    }
+}
 
-        // header
-        fprintf(file, "======= K-MEANS DEBUG RESULTS =======\n\n");
+void debug_results_wait(){
+    if(debug_thread_started){
+        pthread_join(debug_thread, NULL);
+        debug_thread_started = 0;
+    }
+}
 
-        // iteration info
-        fprintf(file, "Total iterations: %d\n\n", iteration_control);
+// text report in the original kmeans.debug.dat layout (needs the reference clusters)
+void write_debug_report(const char* file_name){
+#if defined(HASH_VERIFICATION)
+    load_reference_clusters();
+#endif
+    FILE* file = fopen(file_name, "w");
+    if (!file) { 
+        printf("Erro ao abrir arquivo de debug!\n");
+        return; 
+    }
 
-        // points
-        fprintf(file, "Points (cluster assignment):\n");
-        fprintf(file, "Index    Computed Cluster    Reference Cluster\n");
-        for(int i = 0; i < N_POINTS; i++){
-            fprintf(file, "%5d    %16d    %16d\n", 
-                    i, points[i].cluster, points_cluster_verification[i]);
-        }
-        fprintf(file, "\n");
+    // header
+    fprintf(file, "======= K-MEANS DEBUG RESULTS =======\n\n");
 
-        // means
-        fprintf(file, "Means (x, y, count):\n");
-        fprintf(file, "Index    Computed (x, y, count)          Reference (x, y, count)\n");
-        for(int i = 0; i < N_MEANS; i++){
-            fprintf(file, "%5d    %10.6f %10.6f %5d    %10.6f %10.6f %5d\n", 
-                    i, 
-                    means[i].x, means[i].y, means[i].count, 
-                    means_verification[i].x, means_verification[i].y, means_verification[i].count);
-        }
-        fprintf(file, "\n");
+    // iteration info
+    fprintf(file, "Total iterations: %d\n\n", iteration_control);
 
-        // summary of correctness
-        int correct_points = 0;
-        int correct_means = 0;
+    // points
+    fprintf(file, "Points (cluster assignment):\n");
+    fprintf(file, "Index    Computed Cluster    Reference Cluster\n");
+    for(int i = 0; i < N_POINTS; i++){
+        fprintf(file, "%5d    %16d    %16d\n", 
+                i, points[i].cluster, points_cluster_verification[i]);
+    }
+    fprintf(file, "\n");
+
+    // means
+    fprintf(file, "Means (x, y, count):\n");
+    fprintf(file, "Index    Computed (x, y, count)          Reference (x, y, count)\n");
+    for(int i = 0; i < N_MEANS; i++){
+        fprintf(file, "%5d    %10.6f %10.6f %5d    %10.6f %10.6f %5d\n", 
+                i, 
+                means[i].x, means[i].y, means[i].count, 
+                means_verification[i].x, means_verification[i].y, means_verification[i].count);
+    }
+    fprintf(file, "\n");
 
-        for(int i = 0; i < N_POINTS; i++){
-            if(points[i].cluster == points_cluster_verification[i]){
-                correct_points++;
-            }
-        }
+    // summary of correctness
+    int correct_points = 0;
+    int correct_means = 0;
 
-        for(int i = 0; i < N_MEANS; i++){
-            int is_mean_correct = 0;
-
-			if(means[i].count == means_verification[i].count){
-                is_mean_correct += 1;
-            }
-            is_mean_correct += passed_auxiliary_verification(means[i].x, means_verification[i].x);
-            is_mean_correct += passed_auxiliary_verification(means[i].y, means_verification[i].y);
-            
-            if(is_mean_correct == 3){
-                correct_means++;
-            }
+    for(int i = 0; i < N_POINTS; i++){
+        if(points[i].cluster == points_cluster_verification[i]){
+            correct_points++;
         }
+    }
 
-        fprintf(file, "Correct points: %d / %d\n", correct_points, N_POINTS);
-        fprintf(file, "Correct means:  %d / %d\n", correct_means, N_MEANS);
-        fprintf(file, "Overall verification: %s\n", passed_verification ? "PASSED" : "FAILED");
+    for(int i = 0; i < N_MEANS; i++){
+        int is_mean_correct = 0;
 
-        fclose(file);
+		if(means[i].count == means_verification[i].count){
+            is_mean_correct += 1;
+        }
+        is_mean_correct += passed_auxiliary_verification(means[i].x, means_verification[i].x);
+        is_mean_correct += passed_auxiliary_verification(means[i].y, means_verification[i].y);
+        
+        if(is_mean_correct == 3){
+            correct_means++;
+        }
     }
+
+    fprintf(file, "Correct points: %d / %d\n", correct_points, N_POINTS);
+    fprintf(file, "Correct means:  %d / %d\n", correct_means, N_MEANS);
+    fprintf(file, "Overall verification: %s\n", passed_verification ? "PASSED" : "FAILED");
+
+    fclose(file);
 }
 
 void release_resources(){
-    free(points);
-	free(means);
-	free(points_cluster_verification);
-	free(means_verification);
+	debug_results_wait();
+    arena_free(points);
+	arena_free(means);
+	arena_free(points_cluster_verification);
+	arena_free(means_verification);
+	arena_destroy();
 }
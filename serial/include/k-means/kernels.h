@@ -0,0 +1,96 @@
+// assignment and accumulation kernels, shared by k_means.c and the kernel microbenchmark
+// (kernel_bench.c), which times them in isolation over synthetic points
+
+// the kernels take the number of means as an argument and are always inlined, so every caller
+// that passes a constant (a fixed WORKLOAD, or one of the per-class instances below) gets its
+// own specialization, while the runtime sizes go through the generic instance; returns the
+// number of points that changed cluster
+static inline __attribute__((always_inline)) int find_clusters_kernel(int begin, int end, int means_count, const mean* centroids){
+    int changed = 0;
+    for(int i = begin; i < end; i++){
+        // widen the coordinates once per point (no-op unless COMPACT=ON)
+        double px = points[i].x;
+        double py = points[i].y;
+
+        double min_dist = (px - centroids[0].x) * (px - centroids[0].x)
+                        + (py - centroids[0].y) * (py - centroids[0].y);
+        int min_idx = 0;
+
+        for(int j = 1; j < means_count; j++){
+            double cur_dist = (px - centroids[j].x) * (px - centroids[j].x)
+                            + (py - centroids[j].y) * (py - centroids[j].y);
+            if(cur_dist < min_dist){
+                min_dist = cur_dist;
+                min_idx = j;
+            }
+        }
+
+        if(points[i].cluster != min_idx){
+            points[i].cluster = min_idx;
+            changed++;
+        }
+    }
+    return changed;
+}
+
+// adds the points [begin, end) to the sums (count, x, y) of their clusters
+static inline __attribute__((always_inline)) void accumulate_means_kernel(int begin, int end, mean* sums){
+    for(int i = begin; i < end; i++){
+        int cluster = points[i].cluster;
+        sums[cluster].count++;
+        sums[cluster].x += points[i].x;
+        sums[cluster].y += points[i].y;
+    }
+}
+
+#if defined(WORKLOAD_RUNTIME)
+typedef struct{
+    const char* name;
+    int n_points;
+    int n_means;
+    int (*find_clusters)(int, int, const mean*);
+} kernel_set;
+
+#define KERNEL_SET(class_, means_count) \
+    int find_clusters_##class_(int begin, int end, const mean* centroids){ \
+        return find_clusters_kernel(begin, end, means_count, centroids);}
+
+KERNEL_SET(A, 2)
+KERNEL_SET(B, 10)
+KERNEL_SET(C, 250)
+KERNEL_SET(D, 1000)
+KERNEL_SET(E, 2500)
+KERNEL_SET(F, 5000)
+KERNEL_SET(G, 10000)
+KERNEL_SET(H, 50000)
+KERNEL_SET(generic, N_MEANS)
+
+const kernel_set kernel_sets[] = {
+    {"A", 10, 2, find_clusters_A},
+    {"B", 1000, 10, find_clusters_B},
+    {"C", 10000, 250, find_clusters_C},
+    {"D", 100000, 1000, find_clusters_D},
+    {"E", 250000, 2500, find_clusters_E},
+    {"F", 500000, 5000, find_clusters_F},
+    {"G", 1000000, 10000, find_clusters_G},
+    {"H", 5000000, 50000, find_clusters_H}
+};
+const kernel_set kernel_generic = {"generic", 0, 0, find_clusters_generic};
+const kernel_set* kernels = &kernel_generic;
+
+// picks the instance whose sizes match the data set
+void select_kernels(){
+    kernels = &kernel_generic;
+    for(int i = 0; i < (int)(sizeof(kernel_sets) / sizeof(kernel_sets[0])); i++){
+        if(kernel_sets[i].n_points == N_POINTS && kernel_sets[i].n_means == N_MEANS){
+            kernels = &kernel_sets[i];
+        }
+    }
+    // KMEANS_KERNELS=generic keeps the generic instance, for the sizes where it is faster
+    char* choice = getenv("KMEANS_KERNELS");
+    if(choice != NULL && strcmp(choice, "generic") == 0){
+        kernels = &kernel_generic;
+    }
+    printf(" Workload %s: %d points, %d means, %s kernels\n", (char*)WORKLOAD, N_POINTS, N_MEANS, kernels->name);
+}
+#endif
@@ -0,0 +1,253 @@
+// shared-memory engine for THREADS=ON: a pool of workers that split a range of items in
+// chunks, every worker owns a contiguous run of chunks and, once it runs out, steals the
+// back half of another worker's run
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#define ENGINE_POINTS_CHUNK 1024
+#define ENGINE_MEANS_CHUNK 256
+#define ENGINE_MAX_WORKERS 1024
+
+// processes the items [begin, end) on behalf of the given worker
+typedef void (*engine_task)(int worker, int begin, int end);
+// runs once on every worker
+typedef void (*engine_worker_task)(int worker);
+
+typedef struct{
+    pthread_mutex_t lock;
+    // chunks still owned by the worker: the owner takes from begin, thieves from end
+    int begin;
+    int end;
+    // set by the tasks, read by the main thread once the phase is over
+    int changed;
+    // core the worker is pinned to and its socket (dense index, 0 .. n_sockets - 1)
+    int cpu;
+    int socket;
+} engine_worker;
+
+// one worker per cache line, so the owners do not share lines with each other
+typedef union{
+    engine_worker worker;
+    char padding[128];
+} engine_slot;
+
+typedef struct{
+    int n_workers;
+    pthread_t* threads;
+    engine_slot* slots;
+    pthread_barrier_t start;
+    pthread_barrier_t finish;
+    engine_task task;
+    engine_worker_task worker_task;
+    int n_items;
+    int chunk_size;
+    int stop;
+    int n_sockets;
+} engine_state;
+
+engine_state engine;
+
+// next chunk of the worker: its own first, then one stolen; -1 when every run is empty
+int engine_next_chunk(int worker){
+    engine_worker* self = &engine.slots[worker].worker;
+    pthread_mutex_lock(&self->lock);
+    if(self->begin < self->end){
+        int chunk = self->begin++;
+        pthread_mutex_unlock(&self->lock);
+        return chunk;
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    for(int i = 1; i < engine.n_workers; i++){
+        engine_worker* victim = &engine.slots[(worker + i) % engine.n_workers].worker;
+        pthread_mutex_lock(&victim->lock);
+        int remaining = victim->end - victim->begin;
+        if(remaining <= 0){
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+        int stolen = (remaining + 1) / 2;
+        int end = victim->end;
+        victim->end -= stolen;
+        pthread_mutex_unlock(&victim->lock);
+
+        // the first stolen chunk is processed right away, the rest becomes the new own run
+        pthread_mutex_lock(&self->lock);
+        self->begin = end - stolen + 1;
+        self->end = end;
+        pthread_mutex_unlock(&self->lock);
+        return end - stolen;
+    }
+    // runs only shrink during a phase, so a full empty scan means the phase is done
+    return -1;
+}
+
+// chunks [begin, end) the worker owns at the start of a phase; the first-touch
+// initialization uses the same split, so the owner's chunks live in its socket's memory
+void engine_static_range(int worker, int n_chunks, int* begin, int* end){
+    *begin = (int)((long)n_chunks * worker / engine.n_workers);
+    *end = (int)((long)n_chunks * (worker + 1) / engine.n_workers);
+}
+
+void engine_work(int worker){
+    if(engine.worker_task != NULL){
+        engine.worker_task(worker);
+        return;
+    }
+    int chunk;
+    while((chunk = engine_next_chunk(worker)) >= 0){
+        int begin = chunk * engine.chunk_size;
+        int end = begin + engine.chunk_size;
+        if(end > engine.n_items){
+            end = engine.n_items;
+        }
+        engine.task(worker, begin, end);
+    }
+}
+
+// binds the calling thread to the worker's core, so its first touches stay on its socket
+void engine_pin(int worker){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(engine.slots[worker].worker.cpu, &set);
+    sched_setaffinity(0, sizeof(cpu_set_t), &set);
+}
+
+void* engine_thread(void* argument){
+    int worker = (int)(intptr_t)argument;
+    engine_pin(worker);
+    while(1){
+        pthread_barrier_wait(&engine.start);
+        if(engine.stop){
+            return NULL;
+        }
+        engine_work(worker);
+        pthread_barrier_wait(&engine.finish);
+    }
+}
+
+// runs task over [0, n_items) on every worker, the main thread being worker 0
+void engine_run(engine_task task, int n_items, int chunk_size){
+    int n_chunks = (n_items + chunk_size - 1) / chunk_size;
+    for(int w = 0; w < engine.n_workers; w++){
+        engine_worker* worker = &engine.slots[w].worker;
+        engine_static_range(w, n_chunks, &worker->begin, &worker->end);
+        worker->changed = 0;
+    }
+    engine.task = task;
+    engine.worker_task = NULL;
+    engine.n_items = n_items;
+    engine.chunk_size = chunk_size;
+
+    pthread_barrier_wait(&engine.start);
+    engine_work(0);
+    pthread_barrier_wait(&engine.finish);
+}
+
+// runs task once on every worker (the main thread being worker 0)
+void engine_run_workers(engine_worker_task task){
+    engine.worker_task = task;
+    pthread_barrier_wait(&engine.start);
+    engine_work(0);
+    pthread_barrier_wait(&engine.finish);
+    engine.worker_task = NULL;
+}
+
+// physical package of the cpu, 0 when the topology is not available
+int engine_cpu_package(int cpu){
+    char file_name[96];
+    sprintf(file_name, "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    FILE* file = fopen(file_name, "r");
+    int package = 0;
+    if(file != NULL){
+        if(fscanf(file, "%d", &package) != 1){package = 0;}
+        fclose(file);
+    }
+    return package;
+}
+
+// worker w runs on the w-th core the process may use (round robin beyond that), and its
+// socket is the rank of that core's package among the packages in use
+void engine_topology(){
+    cpu_set_t set;
+    sched_getaffinity(0, sizeof(cpu_set_t), &set);
+    int n_cpus = CPU_COUNT(&set);
+    int* cpus = (int*) malloc(n_cpus * sizeof(int));
+    for(int c = 0, n = 0; n < n_cpus; c++){
+        if(CPU_ISSET(c, &set)){
+            cpus[n++] = c;
+        }
+    }
+
+    int packages[ENGINE_MAX_WORKERS];
+    engine.n_sockets = 0;
+    for(int w = 0; w < engine.n_workers; w++){
+        engine_worker* worker = &engine.slots[w].worker;
+        worker->cpu = cpus[w % n_cpus];
+        int package = engine_cpu_package(worker->cpu);
+        worker->socket = -1;
+        for(int s = 0; s < engine.n_sockets; s++){
+            if(packages[s] == package){
+                worker->socket = s;
+            }
+        }
+        if(worker->socket < 0){
+            packages[engine.n_sockets] = package;
+            worker->socket = engine.n_sockets++;
+        }
+    }
+    free(cpus);
+}
+
+// KMEANS_THREADS workers, or one per core the process may use (its affinity mask, narrowed by
+// taskset, a cgroup or the launcher's binding, not every online core)
+void engine_start(){
+    char* threads = getenv("KMEANS_THREADS");
+    cpu_set_t set;
+    sched_getaffinity(0, sizeof(cpu_set_t), &set);
+    engine.n_workers = (threads != NULL) ? atoi(threads) : CPU_COUNT(&set);
+    if(engine.n_workers < 1){
+        engine.n_workers = 1;
+    }
+    if(engine.n_workers > ENGINE_MAX_WORKERS){
+        engine.n_workers = ENGINE_MAX_WORKERS;
+    }
+
+    engine.slots = (engine_slot*) calloc(engine.n_workers, sizeof(engine_slot));
+    engine.threads = (pthread_t*) malloc(engine.n_workers * sizeof(pthread_t));
+    for(int w = 0; w < engine.n_workers; w++){
+        pthread_mutex_init(&engine.slots[w].worker.lock, NULL);
+    }
+    pthread_barrier_init(&engine.start, NULL, engine.n_workers);
+    pthread_barrier_init(&engine.finish, NULL, engine.n_workers);
+    engine.stop = 0;
+    engine.task = NULL;
+    engine.worker_task = NULL;
+
+    engine_topology();
+    engine_pin(0);
+
+    for(int w = 1; w < engine.n_workers; w++){
+        if(pthread_create(&engine.threads[w], NULL, engine_thread, (void*)(intptr_t)w) != 0){
+            printf("Error when trying to create the worker threads!\n");
+            exit(-1);
+        }
+    }
+    printf(" Work-stealing engine: %d workers, %d sockets\n", engine.n_workers, engine.n_sockets);
+}
+
+void engine_stop(){
+    engine.stop = 1;
+    pthread_barrier_wait(&engine.start);
+    for(int w = 1; w < engine.n_workers; w++){
+        pthread_join(engine.threads[w], NULL);
+    }
+    for(int w = 0; w < engine.n_workers; w++){
+        pthread_mutex_destroy(&engine.slots[w].worker.lock);
+    }
+    pthread_barrier_destroy(&engine.start);
+    pthread_barrier_destroy(&engine.finish);
+    free(engine.threads);
+    free(engine.slots);
+}
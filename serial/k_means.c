@@ -1,11 +1,46 @@
+#if defined(THREADS)
+// CPU affinity calls of the work-stealing engine
+#define _GNU_SOURCE
+#endif
 
 #include "include/k-means/k_means.h"
+#include "include/k-means/kernels.h"
+#if defined(THREADS)
+#include "include/k-means/work_stealing.h"
+#endif
 
 int main(int argc, char* argv[]){
-	points = (point*) malloc(N_POINTS * sizeof(point));
-    means = (mean*) malloc(N_MEANS * sizeof(mean));
-    points_cluster_verification = (int*) malloc(N_POINTS * sizeof(int));
-    means_verification = (mean*) malloc(N_MEANS * sizeof(mean));
+#if defined(WORKLOAD_RUNTIME)
+	// data set sizes and the kernels specialized for them
+	select_workload(argc, argv);
+	select_kernels();
+#endif
+
+#if defined(THREADS)
+	engine_start();
+#endif
+#if defined(ARENA)
+	// every array below in one huge-page backed region
+	arena_create(arena_bytes());
+	arena_report();
+#endif
+
+	points = (point*) arena_alloc(N_POINTS * sizeof(point));
+    means = (mean*) arena_alloc(N_MEANS * sizeof(mean));
+#if !defined(HASH_VERIFICATION)
+    points_cluster_verification = (int*) arena_alloc(N_POINTS * sizeof(int));
+#endif
+    means_verification = (mean*) arena_alloc(N_MEANS * sizeof(mean));
+
+#if defined(THREADS)
+	worker_sums = (mean*) arena_alloc((size_t)engine.n_workers * N_MEANS * sizeof(mean));
+	means_replicas = (mean**) malloc(engine.n_sockets * sizeof(mean*));
+	for(int s = 0; s < engine.n_sockets; s++){
+		means_replicas[s] = (engine.n_sockets > 1) ? (mean*) arena_alloc(N_MEANS * sizeof(mean)) : means;
+	}
+	// the pages of every slice are placed by the worker that processes it
+	engine_run_workers(first_touch_task);
+#endif
 
 	// initial values
 	initialization();
@@ -38,12 +73,37 @@ int main(int argc, char* argv[]){
 	// checksum routine
 	verification();
 
+#if defined(ROOFLINE)
+	// after the run, so the probe does not disturb it
+	roofline_measure();
+#endif
+
 	// print results
 	debug_results();	
 
 	// freeing memory and stuff
+#if defined(THREADS)
+	engine_stop();
+	arena_free(worker_sums);
+	if(engine.n_sockets > 1){
+		for(int s = 0; s < engine.n_sockets; s++){
+			arena_free(means_replicas[s]);
+		}
+	}
+	free(means_replicas);
+#endif
 	release_resources();
 
+	// fields of the structured report (KMEANS_REPORT_FILE)
+	report_integer("n_points", N_POINTS);
+	report_integer("n_means", N_MEANS);
+	report_integer("ranks", 1);
+#if defined(THREADS)
+	report_integer("threads", engine.n_workers);
+#else
+	report_integer("threads", 1);
+#endif
+	report_integer("iterations", iteration_control);
 	execution_report((char*)"K-Means", (char*)WORKLOAD, timer_read(TIMER_TOTAL), passed_verification);
 
 	return 0;
@@ -53,39 +113,184 @@ void k_means(){
 	modified = 1;
     iteration_control = 0;
 
+    // every iteration and its two phases, in the Regions section of the report
+    int region_iteration = timer_region("iteration");
+    int region_find_clusters = timer_region("find_clusters");
+    int region_calculate_means = timer_region("calculate_means");
+
+#if defined(TRACE)
+    trace_setup(N_MEANS);
+#endif
+
     while(modified){
+        if(timer_flag){timer_region_start(region_iteration);}
         modified = 0;
+#if defined(TRACE)
+        double trace_start = timer_elapsed_time();
+        for(int i = 0; i < N_MEANS; i++){
+            trace_save(i, means[i].x, means[i].y);
+        }
+#endif
 
+        if(timer_flag){timer_region_start(region_find_clusters);}
         find_clusters();
+        if(timer_flag){timer_region_stop(region_find_clusters);}
+#if defined(TRACE)
+        double trace_assigned = timer_elapsed_time();
+#endif
 
+        if(timer_flag){timer_region_start(region_calculate_means);}
         calculate_means();
+        if(timer_flag){timer_region_stop(region_calculate_means);}
 
         iteration_control++;
+#if defined(TRACE)
+        double trace_done = trace_iteration(trace_start, trace_assigned, timer_elapsed_time());
+#endif
+        if(timer_flag){timer_region_stop(region_iteration);}
 	    printf(" iteration_control modified %d\n", modified);
+#if defined(TRACE)
+        // the rest of the iteration, leaving out the statistics of the trace
+        trace_records[trace_n_records - 1].other_time = timer_elapsed_time() - trace_done;
+#endif
     }
+
+#if defined(TRACE)
+#if defined(THREADS)
+    trace_write(WORKLOAD, "serial", N_POINTS, N_MEANS, 1, engine.n_workers);
+#else
+    trace_write(WORKLOAD, "serial", N_POINTS, N_MEANS, 1, 1);
+#endif
+    trace_release();
+#endif
 }
 
-void find_clusters(){
-    for(int i = 0; i < N_POINTS; i++){
-        double min_dist = (points[i].x - means[0].x) * (points[i].x - means[0].x)
-                        + (points[i].y - means[0].y) * (points[i].y - means[0].y);
-        int min_idx = 0;
-
-        for(int j = 1; j < N_MEANS; j++){
-            double cur_dist = (points[i].x - means[j].x) * (points[i].x - means[j].x)
-                            + (points[i].y - means[j].y) * (points[i].y - means[j].y);
-            if(cur_dist < min_dist){
-                min_dist = cur_dist;
-                min_idx = j;
-            }
+#if defined(ARENA)
+// size of the arena: every array main() allocates, each rounded to the arena alignment
+size_t arena_bytes(){
+    size_t bytes = arena_size(N_POINTS * sizeof(point)) + 2 * arena_size(N_MEANS * sizeof(mean));
+#if !defined(HASH_VERIFICATION)
+    bytes += arena_size(N_POINTS * sizeof(int));
+#endif
+#if defined(THREADS)
+    bytes += arena_size((size_t)engine.n_workers * N_MEANS * sizeof(mean));
+    bytes += engine.n_sockets * arena_size(N_MEANS * sizeof(mean));
+#endif
+    return bytes;
+}
+#endif
+
+int find_clusters_range(int begin, int end, const mean* centroids){
+#if defined(WORKLOAD_RUNTIME)
+    return kernels->find_clusters(begin, end, centroids);
+#else
+    return find_clusters_kernel(begin, end, N_MEANS, centroids);
+#endif
+}
+
+#if defined(THREADS)
+// first worker of each socket, the one that places and refreshes the socket's replica
+int socket_leader(int worker){
+    for(int w = 0; w < worker; w++){
+        if(engine.slots[w].worker.socket == engine.slots[worker].worker.socket){
+            return 0;
         }
+    }
+    return 1;
+}
+
+// writes the worker's slice of the points and its own sums before anything else does
+void first_touch_task(int worker){
+    int begin, end;
+    engine_static_range(worker, (N_POINTS + ENGINE_POINTS_CHUNK - 1) / ENGINE_POINTS_CHUNK, &begin, &end);
+    begin *= ENGINE_POINTS_CHUNK;
+    end = (end * ENGINE_POINTS_CHUNK < N_POINTS) ? end * ENGINE_POINTS_CHUNK : N_POINTS;
+    if(begin < end){
+        memset(&points[begin], 0, (size_t)(end - begin) * sizeof(point));
+    }
+    memset(&worker_sums[(size_t)worker * N_MEANS], 0, N_MEANS * sizeof(mean));
+
+    // a single socket reads the means directly
+    int socket = engine.slots[worker].worker.socket;
+    if(engine.n_sockets > 1 && socket_leader(worker)){
+        memset(means_replicas[socket], 0, N_MEANS * sizeof(mean));
+    }
+}
+
+// copies the updated means into the replica of the worker's socket
+void refresh_replicas_task(int worker){
+    if(engine.n_sockets > 1 && socket_leader(worker)){
+        memcpy(means_replicas[engine.slots[worker].worker.socket], means, N_MEANS * sizeof(mean));
+    }
+}
+
+void find_clusters_task(int worker, int begin, int end){
+    // the assignment only reads the means of its own socket
+    engine.slots[worker].worker.changed += find_clusters_range(begin, end, means_replicas[engine.slots[worker].worker.socket]);
+}
 
-        if(points[i].cluster != min_idx){
-            points[i].cluster = min_idx;
-            modified = 1;
+void accumulate_means_task(int worker, int begin, int end){
+    accumulate_means_kernel(begin, end, &worker_sums[(size_t)worker * N_MEANS]);
+}
+
+// combines the workers' sums of the means [begin, end) and clears them for the next iteration
+void reduce_means_task(int worker, int begin, int end){
+    for(int w = 0; w < engine.n_workers; w++){
+        mean* sums = &worker_sums[(size_t)w * N_MEANS];
+        for(int i = begin; i < end; i++){
+            means[i].count += sums[i].count;
+            means[i].x += sums[i].x;
+            means[i].y += sums[i].y;
+            sums[i].count = 0;
+            sums[i].x = 0.0;
+            sums[i].y = 0.0;
+        }
+    }
+    for(int i = begin; i < end; i++){
+        if(means[i].count > 0){
+            means[i].x /= means[i].count;
+            means[i].y /= means[i].count;
         }
     }
 }
+#endif
+
+#if defined(TRACE)
+// record of the iteration that just ended: the phase times, the points reassigned, the shifts
+// of the means saved before it and the SSE under the updated means; returns when it is done
+double trace_iteration(double start, double assigned, double updated){
+    trace_record* record = trace_next(iteration_control);
+    record->reassigned = reassigned;
+    record->assign_time = assigned - start;
+    record->update_time = updated - assigned;
+    for(int i = 0; i < N_MEANS; i++){
+        trace_shift(record, i, means[i].x, means[i].y);
+    }
+    for(int i = 0; i < N_POINTS; i++){
+        const mean* center = &means[points[i].cluster];
+        double dx = points[i].x - center->x;
+        double dy = points[i].y - center->y;
+        record->sse += dx * dx + dy * dy;
+    }
+    return timer_elapsed_time();
+}
+#endif
+
+void find_clusters(){
+#if defined(THREADS)
+    engine_run_workers(refresh_replicas_task);
+    engine_run(find_clusters_task, N_POINTS, ENGINE_POINTS_CHUNK);
+    reassigned = 0;
+    for(int w = 0; w < engine.n_workers; w++){
+        reassigned += engine.slots[w].worker.changed;
+    }
+#else
+    reassigned = find_clusters_range(0, N_POINTS, means);
+#endif
+    if(reassigned){
+        modified = 1;
+    }
+}
 
 void calculate_means(){
     for(int i = 0; i < N_MEANS; i++){
@@ -94,12 +299,12 @@ void calculate_means(){
         means[i].y = 0.0;
     }
 
-    for(int i = 0; i < N_POINTS; i++){
-        int cluster = points[i].cluster;
-        means[cluster].count++;
-        means[cluster].x += points[i].x;
-        means[cluster].y += points[i].y;
-    }
+#if defined(THREADS)
+    // sums of integer coordinates, so the split among the workers does not change the result
+    engine_run(accumulate_means_task, N_POINTS, ENGINE_POINTS_CHUNK);
+    engine_run(reduce_means_task, N_MEANS, ENGINE_MEANS_CHUNK);
+#else
+    accumulate_means_kernel(0, N_POINTS, means);
 
     for(int i = 0; i < N_MEANS; i++){
         if(means[i].count > 0){
@@ -107,4 +312,48 @@ void calculate_means(){
             means[i].y /= means[i].count;
         }
     }
+#endif
+}
+
+#if defined(ROOFLINE)
+#if defined(THREADS)
+// the workers probe at the same time, each on its share of the stream arrays
+void roofline_task(int worker){
+    roofline_probe(roofline_stream_length() / engine.n_workers, &roofline_worker_flops[worker], &roofline_worker_bytes[worker]);
+}
+#endif
+
+// peaks of the run's threads and the counts of the iterations: find_clusters computes a
+// distance per point x mean, reading every point and the means once per worker;
+// calculate_means adds up x and y of every point and divides the means, reading every point
+// and writing and reducing the sums of every worker. The workers' means and sums only reach
+// memory when they do not fit in the last-level cache
+void roofline_measure(){
+    double flops = 0.0, bytes = 0.0;
+#if defined(THREADS)
+    int units = engine.n_workers;
+    roofline_worker_flops = (double*) calloc(units, sizeof(double));
+    roofline_worker_bytes = (double*) calloc(units, sizeof(double));
+    engine_run_workers(roofline_task);
+    for(int w = 0; w < units; w++){
+        flops += roofline_worker_flops[w];
+        bytes += roofline_worker_bytes[w];
+    }
+    free(roofline_worker_flops);
+    free(roofline_worker_bytes);
+#else
+    int units = 1;
+    roofline_probe(roofline_stream_length(), &flops, &bytes);
+#endif
+    roofline_peak(flops, bytes);
+
+    double iterations = iteration_control;
+    double point_bytes = (double)N_POINTS * sizeof(point);
+    double worker_mean_bytes = (double)units * N_MEANS * sizeof(mean);
+    double mean_bytes = roofline_memory_bytes(worker_mean_bytes, worker_mean_bytes);
+    roofline_phase("find_clusters", iterations * DISTANCE_FLOPS * N_POINTS * N_MEANS,
+        iterations * (point_bytes + mean_bytes), timer_region_read(timer_region("find_clusters")));
+    roofline_phase("calculate_means", iterations * (2.0 * N_POINTS + 2.0 * N_MEANS),
+        iterations * (point_bytes + 2.0 * mean_bytes), timer_region_read(timer_region("calculate_means")));
 }
+#endif
@@ -0,0 +1,222 @@
+// CPU affinity calls of the work-stealing engine
+#define _GNU_SOURCE
+
+#include "include/k-means/k_means.h"
+#include "include/k-means/work_stealing.h"
+#include "include/k-means/kernels.h"
+
+// microbenchmark of the k-means kernels: times find_clusters (the generic instance and, when K
+// is the one of a workload class, the specialized instance) and the accumulation of the means
+// over synthetic points, for every combination of the lists given on the command line
+// usage: ./kernel_bench.exe [--points=N,...] [--means=K,...] [--threads=T,...]
+//                           [--distribution=uniform,blobs,skewed] [--time=seconds]
+// (no data set is read; N and K are the runtime sizes of WORKLOAD_RUNTIME)
+
+#define BENCH_MAX_VALUES 16
+#define BENCH_MIN_REPETITIONS 3
+#define BENCH_SEED 0x6b62656e6368ULL
+
+typedef struct{
+    int n;
+    int values[BENCH_MAX_VALUES];
+} bench_list;
+
+const char* distributions[] = {"uniform", "blobs", "skewed"};
+#define N_DISTRIBUTIONS ((int)(sizeof(distributions) / sizeof(distributions[0])))
+
+// sums of each worker, N_MEANS per worker
+mean* bench_sums;
+const kernel_set* bench_kernels;
+
+// counter-based random generator (splitmix64 finalizer, as in the data generator)
+uint64_t bench_random(uint64_t stream, uint64_t index){
+    uint64_t z = BENCH_SEED ^ (stream << 48);
+    z += (index + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// comma-separated integers
+void parse_list(const char* text, bench_list* list){
+    list->n = 0;
+    while(*text != '\0' && list->n < BENCH_MAX_VALUES){
+        char* next;
+        list->values[list->n] = (int)strtol(text, &next, 10);
+        if(next == text || list->values[list->n] < 1){
+            printf("Error: invalid list %s!\n", text);
+            exit(-1);
+        }
+        list->n++;
+        text = (*next == ',') ? next + 1 : next;
+    }
+}
+
+// points and initial means of the distribution:
+// uniform: every coordinate in [0, INTERVAL), like the data generator
+// blobs:   points around K centers (the means start on the centers), as in a converged run
+// skewed:  half of the points packed in the first percent of the square, the rest uniform
+void bench_initialize(int distribution){
+    for(int i = 0; i < N_MEANS; i++){
+        means[i].x = bench_random(2, i) % INTERVAL;
+        means[i].y = bench_random(3, i) % INTERVAL;
+        means[i].count = 0;
+    }
+    int spread = INTERVAL / 100 + 1;
+    for(int i = 0; i < N_POINTS; i++){
+        uint64_t rx = bench_random(0, i), ry = bench_random(1, i);
+        int x = rx % INTERVAL, y = ry % INTERVAL;
+        if(distribution == 1){
+            const mean* center = &means[bench_random(4, i) % N_MEANS];
+            x = (int)center->x + (int)(rx % (2 * spread)) - spread;
+            y = (int)center->y + (int)(ry % (2 * spread)) - spread;
+            x = (x < 0) ? 0 : (x >= INTERVAL) ? INTERVAL - 1 : x;
+            y = (y < 0) ? 0 : (y >= INTERVAL) ? INTERVAL - 1 : y;
+        }
+        else if(distribution == 2 && (i % 2) == 0){
+            x = rx % spread;
+            y = ry % spread;
+        }
+        points[i].x = x;
+        points[i].y = y;
+        points[i].cluster = 0;
+    }
+}
+
+void bench_find_task(int worker, int begin, int end){
+    bench_kernels->find_clusters(begin, end, means);
+}
+
+void bench_accumulate_task(int worker, int begin, int end){
+    accumulate_means_kernel(begin, end, &bench_sums[(size_t)worker * N_MEANS]);
+}
+
+void bench_clear_task(int worker){
+    memset(&bench_sums[(size_t)worker * N_MEANS], 0, N_MEANS * sizeof(mean));
+}
+
+// one pass of the kernel over every point
+void bench_pass(int accumulate){
+    if(accumulate){
+        engine_run_workers(bench_clear_task);
+        engine_run(bench_accumulate_task, N_POINTS, ENGINE_POINTS_CHUNK);
+    }
+    else{
+        engine_run(bench_find_task, N_POINTS, ENGINE_POINTS_CHUNK);
+    }
+}
+
+// repeats the pass for at least min_time seconds (and BENCH_MIN_REPETITIONS times), prints the
+// best pass: operations per second (point x mean distances for find_clusters, points for the
+// accumulation) and the compulsory traffic (points once, plus the means or the sums of every
+// worker once) in GB/s
+void bench_kernel(const char* kernel, int distribution, int accumulate, double min_time){
+    bench_pass(accumulate);
+
+    double best = 0.0, total = 0.0;
+    int repetitions = 0;
+    while(repetitions < BENCH_MIN_REPETITIONS || total < min_time){
+        double start = timer_elapsed_time();
+        bench_pass(accumulate);
+        double elapsed = timer_elapsed_time() - start;
+        if(repetitions == 0 || elapsed < best){
+            best = elapsed;
+        }
+        total += elapsed;
+        repetitions++;
+    }
+
+    double bytes = (double)N_POINTS * sizeof(point);
+    bytes += (accumulate ? 2.0 * engine.n_workers : 1.0) * N_MEANS * sizeof(mean);
+    double pairs = accumulate ? (double)N_POINTS : (double)N_POINTS * N_MEANS;
+    printf(" %-16s %-8s %10d %8d %7d %6d %12.6f %12.4f %10.3f\n", kernel, distributions[distribution],
+        N_POINTS, N_MEANS, engine.n_workers, repetitions, best, pairs / best * 1.0e-9, bytes / best * 1.0e-9);
+}
+
+int main(int argc, char* argv[]){
+    bench_list point_list = {3, {10000, 100000, 1000000}};
+    bench_list mean_list = {3, {10, 250, 1000}};
+    bench_list thread_list = {1, {1}};
+    int use_distribution[N_DISTRIBUTIONS] = {1, 1, 1};
+    double min_time = 0.2;
+
+    for(int i = 1; i < argc; i++){
+        if(strncmp(argv[i], "--points=", 9) == 0){
+            parse_list(argv[i] + 9, &point_list);
+        }
+        else if(strncmp(argv[i], "--means=", 8) == 0){
+            parse_list(argv[i] + 8, &mean_list);
+        }
+        else if(strncmp(argv[i], "--threads=", 10) == 0){
+            parse_list(argv[i] + 10, &thread_list);
+        }
+        else if(strncmp(argv[i], "--distribution=", 15) == 0){
+            for(int d = 0; d < N_DISTRIBUTIONS; d++){
+                use_distribution[d] = (strstr(argv[i] + 15, distributions[d]) != NULL);
+            }
+        }
+        else if(strncmp(argv[i], "--time=", 7) == 0){
+            min_time = atof(argv[i] + 7);
+        }
+        else{
+            printf("Error: unknown option %s!\n", argv[i]);
+            printf("Usage: %s [--points=N,...] [--means=K,...] [--threads=T,...] [--distribution=uniform,blobs,skewed] [--time=seconds]\n", argv[0]);
+            exit(-1);
+        }
+    }
+
+    setup_common();
+    strcpy(workload_name, "bench");
+
+    int max_points = 0, max_means = 0, max_threads = 0;
+    for(int i = 0; i < point_list.n; i++){max_points = (point_list.values[i] > max_points) ? point_list.values[i] : max_points;}
+    for(int i = 0; i < mean_list.n; i++){max_means = (mean_list.values[i] > max_means) ? mean_list.values[i] : max_means;}
+    for(int i = 0; i < thread_list.n; i++){max_threads = (thread_list.values[i] > max_threads) ? thread_list.values[i] : max_threads;}
+    points = (point*) malloc((size_t)max_points * sizeof(point));
+    means = (mean*) malloc((size_t)max_means * sizeof(mean));
+    bench_sums = (mean*) malloc((size_t)max_threads * max_means * sizeof(mean));
+    if(points == NULL || means == NULL || bench_sums == NULL){
+        printf("Error when trying to allocate the benchmark data!\n");
+        exit(-1);
+    }
+
+    printf(" %-16s %-8s %10s %8s %7s %6s %12s %12s %10s\n", "Kernel", "Data", "N", "K", "Threads", "Reps", "Best (s)", "Gops/s", "GB/s");
+    for(int t = 0; t < thread_list.n; t++){
+        char threads[16];
+        sprintf(threads, "%d", thread_list.values[t]);
+        setenv("KMEANS_THREADS", threads, 1);
+        engine_start();
+        for(int d = 0; d < N_DISTRIBUTIONS; d++){
+            if(!use_distribution[d]){
+                continue;
+            }
+            for(int p = 0; p < point_list.n; p++){
+                for(int m = 0; m < mean_list.n; m++){
+                    n_points = point_list.values[p];
+                    n_means = mean_list.values[m];
+                    bench_initialize(d);
+
+                    // the generic instance, then the specialized one of the class with this K
+                    bench_kernels = &kernel_generic;
+                    bench_kernel("find_clusters", d, 0, min_time);
+                    for(int k = 0; k < (int)(sizeof(kernel_sets) / sizeof(kernel_sets[0])); k++){
+                        if(kernel_sets[k].n_means == N_MEANS){
+                            char name[32];
+                            sprintf(name, "find_clusters_%s", kernel_sets[k].name);
+                            bench_kernels = &kernel_sets[k];
+                            bench_kernel(name, d, 0, min_time);
+                            break;
+                        }
+                    }
+                    bench_kernel("accumulate", d, 1, min_time);
+                }
+            }
+        }
+        engine_stop();
+    }
+
+    free(points);
+    free(means);
+    free(bench_sums);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "include/common/trace.h"
+
+// converts the trace of a TRACE=ON run (kmeans.trace.bin) into a text table (kmeans.trace.dat)
+// or, when the output file ends in .csv, into a CSV file with a header
+// usage: ./trace_converter.exe [trace file] [output file]
+int main(int argc, char* argv[]){
+    char* trace_name = (argc > 1) ? argv[1] : (char*)TRACE_FILE;
+    char* output_name = (argc > 2) ? argv[2] : (char*)TRACE_REPORT_FILE;
+    size_t length = strlen(output_name);
+    int csv = (length > 4 && strcmp(output_name + length - 4, ".csv") == 0);
+
+    FILE* file = fopen(trace_name, "rb");
+    if(file == NULL){
+        printf("Error when trying to open %s!\n", trace_name);
+        exit(-1);
+    }
+    trace_header header;
+    if(fread(&header, sizeof(trace_header), 1, file) != 1 || memcmp(header.magic, TRACE_MAGIC, 4) != 0){
+        printf("Error: %s is not a k-means trace!\n", trace_name);
+        exit(-1);
+    }
+    trace_record* records = (trace_record*) malloc((header.n_records + 1) * sizeof(trace_record));
+    if(fread(records, sizeof(trace_record), header.n_records, file) != (size_t)header.n_records){
+        printf("Error: %s is truncated!\n", trace_name);
+        exit(-1);
+    }
+    fclose(file);
+
+    FILE* output = fopen(output_name, "w");
+    if(output == NULL){
+        printf("Error when trying to open %s!\n", output_name);
+        exit(-1);
+    }
+    if(csv){
+        fprintf(output, "iteration,reassigned,max_shift,mean_shift,sse,pruned,assign_time,update_time,other_time\n");
+    }
+    else{
+        fprintf(output, "# %s, workload %s: %d points, %d means, %d ranks x %d threads, %d iterations\n",
+            header.variant, header.workload, header.n_points, header.n_means, header.ranks, header.threads, header.n_records);
+        fprintf(output, "%9s %12s %14s %14s %20s %8s %12s %12s %12s\n", "iteration", "reassigned", "max_shift",
+            "mean_shift", "sse", "pruned", "assign (s)", "update (s)", "other (s)");
+    }
+    double total[3] = {0.0, 0.0, 0.0};
+    for(int r = 0; r < header.n_records; r++){
+        const trace_record* record = &records[r];
+        fprintf(output, csv ? "%d,%d,%.9g,%.9g,%.17g,%.4f,%.9f,%.9f,%.9f\n" : "%9d %12d %14.6g %14.6g %20.10g %8.4f %12.6f %12.6f %12.6f\n",
+            record->iteration, record->reassigned, record->max_shift, record->mean_shift, record->sse,
+            record->pruned, record->assign_time, record->update_time, record->other_time);
+        total[0] += record->assign_time;
+        total[1] += record->update_time;
+        total[2] += record->other_time;
+    }
+    if(!csv){
+        fprintf(output, "%9s %12s %14s %14s %20s %8s %12.6f %12.6f %12.6f\n", "total", "", "", "", "", "", total[0], total[1], total[2]);
+    }
+    fclose(output);
+    free(records);
+    printf(" %d iterations written to %s\n", header.n_records, output_name);
+    return 0;
+}